@@ -0,0 +1,398 @@
+// timings of exported simulation kernels on synthetic worlds
+//
+// usage: benchmark [--warmup N] [--repetitions N] [--output <file>] [--small]
+// results are written as json: one entry per kernel, variant and world size with mean and percentiles in milliseconds
+// kernels which read inventories run once with dense and once with sparse inventories,
+// each on a freshly built world with inventories restored before every repetition
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data.hpp"
+#include "sote_functions.hpp"
+#include "sote_types.hpp"
+#include "rng.hpp"
+
+dcon::data_container state {};
+
+constexpr uint64_t benchmark_seed = 0x5eed;
+constexpr uint32_t trade_goods_count = 20;
+constexpr uint32_t use_cases_count = 10;
+constexpr uint32_t needs_count = 6;
+constexpr uint32_t pops_per_settlement = 50;
+
+// keeps results of scalar loops observable
+static volatile double sink;
+
+struct world_size {
+	uint32_t tiles;
+	uint32_t pops;
+};
+
+struct result {
+	std::string kernel;
+	std::string variant;
+	world_size size;
+	std::vector<double> samples;
+	// bytes of inventories and their masks, zero for kernels which do not read them
+	size_t inventory_bytes = 0;
+};
+
+static float uniform(uint64_t id, uint64_t stream) {
+	return rng::uniform(benchmark_seed, id, stream);
+}
+
+static void build_tiles(uint32_t count) {
+	state.tile_resize(count);
+
+	for (uint32_t i = 0; i < 8; i++) {
+		state.create_bedrock();
+	}
+	for (uint32_t i = 0; i < 12; i++) {
+		auto biome = state.create_biome();
+		state.biome_set_minimum_elevation(biome, -1000.f + 500.f * i);
+		state.biome_set_maximum_elevation(biome, 500.f * (i + 1));
+	}
+	for (uint32_t i = 0; i < 20; i++) {
+		auto resource = state.create_resource();
+		state.resource_set_land(resource, i % 4 != 0);
+		state.resource_set_water(resource, i % 4 == 0);
+		state.resource_set_minimum_elevation(resource, -10000.f);
+		state.resource_set_maximum_elevation(resource, 10000.f);
+		state.resource_set_maximum_trees(resource, 1.f);
+		state.resource_set_base_frequency(resource, 100.f + 50.f * i);
+	}
+
+	state.for_each_tile([&](dcon::tile_id tile) {
+		auto id = (uint64_t)tile.index();
+		auto elevation = uniform(id, 0) * 8000.f - 3000.f;
+		state.tile_set_elevation(tile, elevation);
+		state.tile_set_is_land(tile, elevation > 0.f);
+		state.tile_set_is_coast(tile, std::abs(elevation) < 50.f);
+		state.tile_set_slope(tile, uniform(id, 1));
+		state.tile_set_bedrock(tile, dcon::bedrock_id{ dcon::bedrock_id::value_base_t(id % 8) });
+		state.tile_set_sand(tile, uniform(id, 2) * 0.5f);
+		state.tile_set_silt(tile, uniform(id, 3) * 0.5f);
+		state.tile_set_clay(tile, uniform(id, 4) * 0.5f);
+		state.tile_set_soil_minerals(tile, uniform(id, 5));
+		state.tile_set_january_temperature(tile, uniform(id, 6) * 60.f - 30.f);
+		state.tile_set_july_temperature(tile, uniform(id, 7) * 60.f - 20.f);
+		state.tile_set_january_rain(tile, uniform(id, 8) * 300.f);
+		state.tile_set_ice(tile, uniform(id, 9) < 0.05f ? 1.f : 0.f);
+		state.tile_set_conifer(tile, uniform(id, 10) * 0.3f);
+		state.tile_set_broadleaf(tile, uniform(id, 11) * 0.3f);
+		state.tile_set_shrub(tile, uniform(id, 12) * 0.3f);
+		state.tile_set_grass(tile, uniform(id, 13) * 0.3f);
+		state.tile_set_ideal_conifer(tile, uniform(id, 14) * 0.3f);
+		state.tile_set_ideal_broadleaf(tile, uniform(id, 15) * 0.3f);
+		state.tile_set_ideal_shrub(tile, uniform(id, 16) * 0.3f);
+		state.tile_set_ideal_grass(tile, uniform(id, 17) * 0.3f);
+	});
+}
+
+// settlements of fifty pops, households of an adult with two children,
+// one estate per settlement with a building for every adult
+static void build_pops(uint32_t count) {
+	for (uint32_t i = 0; i < trade_goods_count; i++) {
+		auto trade_good = state.create_trade_good();
+		state.trade_good_set_decay(trade_good, i % 3 == 0 ? 1.f : 0.98f);
+	}
+	for (uint32_t i = 0; i < use_cases_count; i++) {
+		auto use_case = state.create_use_case();
+		state.use_case_set_good_consumption(use_case, 1.f);
+		for (uint32_t j = 0; j < 3; j++) {
+			auto trade_good = dcon::trade_good_id{ dcon::trade_good_id::value_base_t((i * 3 + j) % trade_goods_count) };
+			auto weight = state.force_create_use_weight(trade_good, use_case);
+			state.use_weight_set_weight(weight, 1.f / (j + 1));
+		}
+	}
+	for (uint32_t i = 0; i < needs_count; i++) {
+		auto need = state.create_need();
+		state.need_set_life_need(need, i < 2);
+	}
+
+	auto race = state.create_race();
+	state.race_set_child_age(race, 3.f);
+	state.race_set_teen_age(race, 12.f);
+	state.race_set_adult_age(race, 16.f);
+	state.race_set_middle_age(race, 40.f);
+	state.race_set_elder_age(race, 60.f);
+	state.race_set_max_age(race, 80.f);
+
+	state.pop_resize_need_satisfaction(needs_count + 1);
+
+	dcon::settlement_id settlement {};
+	dcon::estate_id estate {};
+	dcon::pop_id parent {};
+	for (uint32_t i = 0; i < count; i++) {
+		if (i % pops_per_settlement == 0) {
+			settlement = state.create_settlement();
+			estate = state.create_estate();
+			state.estate_set_savings(estate, 1000.f);
+			state.force_create_estate_location(settlement, estate);
+		}
+
+		auto pop = state.create_pop();
+		state.pop_set_race(pop, race);
+		state.force_create_pop_location(settlement, pop);
+
+		// every third pop is a child of the previous adult
+		bool child = i % 3 != 0 && parent;
+		state.pop_set_birth_year(pop, child ? 95 : 60 + int32_t(i % 30));
+		state.pop_set_birth_tick(pop, i % 1000);
+		if (child) {
+			state.force_create_parent_child_relation(parent, pop);
+		} else {
+			parent = pop;
+			auto building = state.create_building();
+			state.force_create_building_estate(estate, building);
+			state.force_create_employment(building, pop);
+			state.pop_set_work_ratio(pop, 0.5f);
+		}
+
+		state.pop_set_savings(pop, 10.f);
+		state.pop_set_forage_ratio(pop, 0.5f);
+		for (uint32_t j = 0; j < needs_count; j++) {
+			auto& need = state.pop_get_need_satisfaction(pop, j);
+			need.need = NEED(j + 1);
+			need.use_case = int32_t(j % use_cases_count) + 1;
+			need.demanded = 1.f;
+			need.consumed = 0.f;
+		}
+		for (uint32_t j = 0; j < trade_goods_count; j++) {
+			auto trade_good = dcon::trade_good_id{ dcon::trade_good_id::value_base_t(j) };
+			state.pop_set_inventory(pop, trade_good, uniform(pop.index(), 100 + j) * 2.f);
+		}
+	}
+}
+
+static void build_world(world_size size) {
+	state.reset();
+	set_world_seed(benchmark_seed);
+	set_world_tick_definitions(1, 60, 60 * 24, 60 * 24 * 30);
+	set_world_current_year(100);
+	set_world_current_tick(0);
+
+	build_tiles(size.tiles);
+	build_pops(size.pops);
+	update_use_case_table();
+	update_pop_age_cache();
+}
+
+// inventories as they are before the first repetition of a kernel
+struct inventory_snapshot {
+	std::vector<float> inventory;
+	std::vector<uint64_t> mask_low;
+	std::vector<uint64_t> mask_high;
+};
+
+static inventory_snapshot take_inventories() {
+	inventory_snapshot snapshot;
+	auto pops = state.pop_size();
+	auto goods = state.trade_good_size();
+	snapshot.inventory.resize(size_t(pops) * goods);
+	snapshot.mask_low.resize(pops);
+	snapshot.mask_high.resize(pops);
+	state.for_each_pop([&](dcon::pop_id pop) {
+		auto index = size_t(pop.index());
+		for (uint32_t j = 0; j < goods; j++) {
+			auto trade_good = dcon::trade_good_id{ dcon::trade_good_id::value_base_t(j) };
+			snapshot.inventory[index * goods + j] = state.pop_get_inventory(pop, trade_good);
+		}
+		snapshot.mask_low[index] = state.pop_get_inventory_mask_low(pop);
+		snapshot.mask_high[index] = state.pop_get_inventory_mask_high(pop);
+	});
+	return snapshot;
+}
+
+static void restore_inventories(inventory_snapshot const& snapshot) {
+	auto goods = state.trade_good_size();
+	state.for_each_pop([&](dcon::pop_id pop) {
+		auto index = size_t(pop.index());
+		for (uint32_t j = 0; j < goods; j++) {
+			auto trade_good = dcon::trade_good_id{ dcon::trade_good_id::value_base_t(j) };
+			state.pop_set_inventory(pop, trade_good, snapshot.inventory[index * goods + j]);
+		}
+		state.pop_set_inventory_mask_low(pop, snapshot.mask_low[index]);
+		state.pop_set_inventory_mask_high(pop, snapshot.mask_high[index]);
+	});
+}
+
+// dense inventories are a float per pop and trade good, sparse ones add two masks per pop
+static size_t inventory_bytes(bool sparse) {
+	auto bytes = size_t(state.pop_size()) * state.trade_good_size() * sizeof(float);
+	if (sparse) {
+		bytes += size_t(state.pop_size()) * 2 * sizeof(uint64_t);
+	}
+	return bytes;
+}
+
+static double percentile(std::vector<double> const& sorted, double p) {
+	auto index = (size_t)(p * (sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+static result measure(
+	char const* kernel, char const* variant, world_size size,
+	int warmup, int repetitions, std::function<void()> const& f,
+	std::function<void()> const& prepare = {}
+) {
+	result r { kernel, variant, size, {} };
+	for (int i = 0; i < warmup; i++) {
+		if (prepare) prepare();
+		f();
+	}
+	for (int i = 0; i < repetitions; i++) {
+		if (prepare) prepare();
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		r.samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	auto sorted = r.samples;
+	std::sort(sorted.begin(), sorted.end());
+	fprintf(
+		stderr, "%-24s %-8s %8u tiles %7u pops %10.3f ms\n",
+		kernel, variant, size.tiles, size.pops, sorted.empty() ? 0.0 : percentile(sorted, 0.5)
+	);
+	return r;
+}
+
+static void write_json(FILE* file, std::vector<result> const& results) {
+	fprintf(file, "[\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		auto& r = results[i];
+		auto sorted = r.samples;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (auto sample : sorted) sum += sample;
+		auto count = sorted.size();
+		fprintf(
+			file,
+			"\t{\"kernel\": \"%s\", \"variant\": \"%s\", \"tiles\": %u, \"pops\": %u, \"repetitions\": %zu, \"inventory_bytes\": %zu, "
+			"\"mean_ms\": %.6f, \"min_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f}%s\n",
+			r.kernel.c_str(), r.variant.c_str(), r.size.tiles, r.size.pops, count, r.inventory_bytes,
+			count ? sum / count : 0.0,
+			count ? sorted.front() : 0.0,
+			count ? percentile(sorted, 0.5) : 0.0,
+			count ? percentile(sorted, 0.9) : 0.0,
+			count ? percentile(sorted, 0.99) : 0.0,
+			count ? sorted.back() : 0.0,
+			i + 1 < results.size() ? "," : ""
+		);
+	}
+	fprintf(file, "]\n");
+}
+
+int main(int argc, char** argv) {
+	int warmup = 3;
+	int repetitions = 20;
+	char const* output = nullptr;
+	std::vector<world_size> sizes {
+		{ 10000, 10000 },
+		{ 100000, 100000 },
+		{ 1500000, 300000 },
+	};
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warmup = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+			repetitions = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--small") == 0) {
+			sizes.resize(1);
+		} else {
+			fprintf(stderr, "usage: %s [--warmup N] [--repetitions N] [--output <file>] [--small]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<result> results;
+	for (auto size : sizes) {
+		build_world(size);
+
+		auto run = [&](char const* kernel, std::function<void()> const& f) {
+			results.push_back(measure(kernel, "default", size, warmup, repetitions, f));
+		};
+		auto run_inventories = [&](char const* kernel, std::function<void()> const& f) {
+			for (bool sparse : { false, true }) {
+				// both layouts start from the same world: kernels drain inventories
+				build_world(size);
+				if (!set_sparse_inventory(sparse)) continue;
+				// inventory masks are rebuilt by the decay pass
+				decay_inventories();
+				auto snapshot = take_inventories();
+				auto r = measure(
+					kernel, sparse ? "sparse" : "dense", size, warmup, repetitions, f,
+					[&] { restore_inventories(snapshot); }
+				);
+				r.inventory_bytes = inventory_bytes(sparse);
+				fprintf(stderr, "%-24s %-8s %10.3f MiB of inventories\n", kernel, r.variant.c_str(), r.inventory_bytes / (1024.0 * 1024.0));
+				results.push_back(std::move(r));
+			}
+			set_sparse_inventory(false);
+		};
+
+		run("update_vegetation", [] { update_vegetation(0.005f); });
+		run("apply_biome", [] { apply_biome(5); });
+		run("apply_all_biomes", [] {
+			int32_t order[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+			apply_all_biomes(order, 12);
+		});
+		run("apply_resource", [] { apply_resource(3); });
+		run("apply_all_resources", [] { apply_all_resources(); });
+		run("update_pop_age_cache", [] { update_pop_age_cache(); });
+		run("age_years", [] {
+			uint64_t total = 0;
+			state.for_each_pop([&](auto pop) { total += age_years(pop); });
+			sink = (double)total;
+		});
+		run("age_multiplier", [] {
+			float total = 0.f;
+			state.for_each_pop([&](auto pop) { total += age_multiplier(pop); });
+			sink = total;
+		});
+		std::vector<float> time_budget(size_t(state.pop_size()) * 4);
+		run("pops_time_budget_all", [&] {
+			auto count = size_t(state.pop_size());
+			auto data = time_budget.data();
+			pops_time_budget_all(data, data + count, data + 2 * count, data + 3 * count);
+			sink = data[3 * count];
+		});
+		// households by their heads, as lua asks for a selection of pops
+		std::vector<dcon::pop_id> heads;
+		state.for_each_pop([&](dcon::pop_id pop) {
+			if (pop.index() % 3 == 0) heads.push_back(pop);
+		});
+		run("pops_time_budget", [&] {
+			auto count = uint32_t(heads.size());
+			auto data = time_budget.data();
+			pops_time_budget(heads.data(), count, data, data + count, data + 2 * count, data + 3 * count);
+			sink = data[3 * count];
+		});
+		run_inventories("decay_inventories", [] { decay_inventories(); });
+		run_inventories("pops_consume", [] { pops_consume(); });
+		run("estates_pay", [] { estates_pay(); });
+		run("pops_update_stats", [] { pops_update_stats(); });
+		run_inventories("update_economy", [] { update_economy(); });
+	}
+
+	FILE* file = output ? fopen(output, "w") : stdout;
+	if (!file) {
+		fprintf(stderr, "Failed to open %s\n", output);
+		return 1;
+	}
+	write_json(file, results);
+	if (output) fclose(file);
+	return 0;
+}
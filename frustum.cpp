@@ -5,6 +5,9 @@
 
 #include "glm/geometric.hpp"
 
+#include <algorithm>
+#include <limits>
+
 frustum::frustum(glm::mat4 const & view_projection)
 {
 	glm::mat4 m = glm::inverse(view_projection);
@@ -48,3 +51,28 @@ frustum::frustum(glm::mat4 const & view_projection)
 		e(3, 7),
 	};
 }
+
+bool frustum::intersects(glm::vec3 const & center, float radius) const
+{
+	for (auto const & normal : face_normals)
+	{
+		float length = glm::length(normal);
+		if (length == 0.f)
+			continue;
+
+		float min = std::numeric_limits<float>::infinity();
+		float max = -std::numeric_limits<float>::infinity();
+		for (auto const & v : vertices)
+		{
+			float d = glm::dot(v, normal);
+			min = std::min(min, d);
+			max = std::max(max, d);
+		}
+
+		float c = glm::dot(center, normal);
+		float r = radius * length;
+		if (c + r < min || c - r > max)
+			return false;
+	}
+	return true;
+}
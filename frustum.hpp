@@ -17,4 +17,7 @@ struct frustum
 	std::array<glm::vec3, 6> edge_directions;
 
 	frustum(glm::mat4 const & view_projection);
+
+	// conservative test: false only when a face plane separates the sphere from the frustum
+	bool intersects(glm::vec3 const & center, float radius) const;
 };
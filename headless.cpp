@@ -0,0 +1,171 @@
+// simulation without window and renderer:
+// loads raws and the world, advances the lua world tick and reports time spent in each phase
+//
+// usage: headless [--ticks N]
+// the world is loaded from the default images (or their baked cache) and generated like in the game
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lua.hpp"
+#include "data.hpp"
+#include "sote_functions.hpp"
+#include "world_loading.hpp"
+
+dcon::data_container state {};
+
+// raws register names and icons through ffi: the game keeps them in its text collection,
+// here keys are handed out in the same order and textures are never loaded
+static std::vector<std::string> registered_text;
+
+extern "C" {
+	DCON_LUADLL_API uint32_t register_text(int32_t text_len, const char* data);
+	DCON_LUADLL_API uint32_t register_texture(int32_t text_len, const char* data);
+};
+uint32_t register_text(int32_t text_len, const char* data) {
+	registered_text.emplace_back(data, data + text_len);
+	return uint32_t(registered_text.size() - 1);
+}
+uint32_t register_texture(int32_t text_len, const char* data) {
+	return register_text(text_len, data);
+}
+
+static auto const start_time = std::chrono::steady_clock::now();
+
+static double seconds_since_start() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+// replacement of love.timer.getTime used by PROFILER and loaders
+static int get_time(lua_State *L) {
+	lua_pushnumber(L, seconds_since_start());
+	return 1;
+}
+
+static int traceback(lua_State *L) {
+	lua_getfield(L, LUA_GLOBALSINDEX, "debug");
+	lua_getfield(L, -1, "traceback");
+	lua_pushvalue(L, 1);
+	lua_pushinteger(L, 2);
+	lua_call(L, 2, 1);
+	fprintf(stderr, "%s\n", lua_tostring(L, -1));
+	return 1;
+}
+
+// runs a lua chunk with traceback on error and exits if it fails
+static void call_lua(lua_State *L, char const* script) {
+	lua_pushcfunction(L, traceback);
+	// [traceback
+	if (luaL_loadstring(L, script)) {
+		fprintf(stderr, "Couldn't load chunk: %s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+	// [traceback, chunk
+	if (lua_pcall(L, 0, 0, -2)) exit(1);
+	// [traceback
+	lua_pop(L, 1);
+}
+
+int main(int argc, char** argv) {
+	int ticks = 100;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+			ticks = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--ticks N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	lua_State *L = luaL_newstate();
+	luaL_openlibs(L);
+
+	if (luaL_loadfile(L, "./lua/main.lua")) {
+		fprintf(stderr, "Couldn't load file: %s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushcfunction(L, get_time);
+	lua_setfield(L, -2, "getTime");
+	lua_setfield(L, -2, "timer");
+	lua_setglobal(L, "love");
+
+	lua_newtable(L);
+	lua_setglobal(L, "sote");
+
+	lua_newtable(L);
+	lua_setglobal(L, "UI_LOGIC");
+
+	if (lua_pcall(L, 0, LUA_MULTRET, 0)) {
+		fprintf(stderr, "Failed to run script: %s\n", lua_tostring(L, -1));
+		exit(1);
+	}
+
+	call_lua(L, "love.math = { random = math.random }; PROFILE_FLAG = true");
+
+	auto phase_start = seconds_since_start();
+	call_lua(L, "sote.load_raws()");
+	printf("raws: %.3f s\n", seconds_since_start() - phase_start);
+
+	lua_getfield(L, LUA_GLOBALSINDEX, "DEFINES");
+	lua_getfield(L, -1, "world_size");
+	int world_size = (int)(lua_tonumber(L, -1));
+	lua_pop(L, 2);
+
+	phase_start = seconds_since_start();
+	load_default_world(world_size);
+	printf("world: %.3f s\n", seconds_since_start() - phase_start);
+
+	phase_start = seconds_since_start();
+	call_lua(L, "require('game.scenes.world-loader').load_default()");
+	spawn_races();
+	printf("generation: %.3f s\n", seconds_since_start() - phase_start);
+
+	call_lua(L, "PROFILER:clear(); PROFILER.total = 0");
+
+	phase_start = seconds_since_start();
+	for (int i = 0; i < ticks; i++) {
+		call_lua(L, "WORLD:tick()");
+	}
+	auto total = seconds_since_start() - phase_start;
+	printf("%d ticks: %.3f s, %.3f ms per tick\n", ticks, total, ticks > 0 ? total * 1000.0 / ticks : 0.0);
+
+	// phases sorted by total time
+	std::vector<std::pair<std::string, std::pair<double, int>>> phases;
+	lua_getfield(L, LUA_GLOBALSINDEX, "PROFILER");
+	lua_getfield(L, -1, "data");
+	lua_getfield(L, -2, "count");
+	// [PROFILER, data, count
+	lua_pushnil(L);
+	while (lua_next(L, -3)) {
+		// [PROFILER, data, count, tag, time
+		auto time = lua_tonumber(L, -1);
+		lua_pop(L, 1);
+		lua_pushvalue(L, -1);
+		lua_gettable(L, -3);
+		auto count = (int)lua_tonumber(L, -1);
+		lua_pop(L, 1);
+		phases.push_back({ lua_tostring(L, -1), { time, count } });
+	}
+	lua_pop(L, 3);
+
+	std::sort(phases.begin(), phases.end(), [](auto& a, auto& b) { return a.second.first > b.second.first; });
+	printf("%-24s %12s %8s %12s\n", "phase", "total ms", "calls", "mean ms");
+	for (auto& [tag, value] : phases) {
+		auto [time, count] = value;
+		printf("%-24s %12.3f %8d %12.3f\n", tag.c_str(), time * 1000.0, count, count > 0 ? time * 1000.0 / count : 0.0);
+	}
+
+	wait_for_saves();
+	lua_close(L);
+	return 0;
+}
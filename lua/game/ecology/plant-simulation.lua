@@ -579,6 +579,8 @@ function gen.run()
 		SOIL_AERATION[tile] = soil_organic_aeration_factor
 		--]]
 	end
+	-- every tile gets new plants
+	DCON.map_mode_refresh()
 end
 
 return gen
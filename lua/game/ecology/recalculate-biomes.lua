@@ -15,9 +15,11 @@ function re.run_fast()
 	end
 
 
-	for _, b_id in pairs(RAWS_MANAGER.biomes_load_order) do
-		ffi.C.apply_biome(b_id)
+	local load_order = ffi.new("int32_t[?]", #RAWS_MANAGER.biomes_load_order)
+	for i, b_id in ipairs(RAWS_MANAGER.biomes_load_order) do
+		load_order[i - 1] = b_id
 	end
+	ffi.C.apply_all_biomes(load_order, #RAWS_MANAGER.biomes_load_order)
 
 	---@type table<biome_id, number>
 	local tiles_per_biome = {}
@@ -158,6 +160,8 @@ function re.run()
 			::continue::
 		end
 	end)
+	-- biomes of every tile are picked again
+	DCON.map_mode_refresh()
 end
 
 return re
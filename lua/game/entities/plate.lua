@@ -27,6 +27,7 @@ end
 ---@param tile_id tile_id ID of the tile to add!
 function plate.Plate.add_tile(plate_id, tile_id)
 	DATA.force_create_plate_tiles(plate_id, tile_id)
+	DCON.map_mode_mark_tile(tile_id)
 end
 
 return plate
@@ -13,6 +13,8 @@ rtab.POP = {}
 ---@return pop_id
 function rtab.POP.new(race, faith, culture, female, year, birth_tick)
 	local r = POP.create()
+	-- slot could belong to a deleted pop with a cached age
+	DCON.pop_reset_age_cache(r.id)
 
 	assert(faith ~= nil)
 	assert(culture ~= nil)
@@ -74,6 +74,7 @@ local dbm              = require "game.economy.diet-breadth-model"
 ---@field month number
 ---@field year number
 ---@field world_size number
+---@field seed number seed of random numbers of the backend, saved so a loaded world rolls the same values
 ---@field province_count number
 ---@field tile_to_climate_cell table<tile_id, climate_cell_id>
 ---@field climate_grid_size number number of climate grid cells along a grid edge
@@ -146,6 +147,7 @@ function world.World:new()
 
 	w.entity_counter = 2
 	w.world_size = ws
+	w.seed = love.math.random(1, 2147483647)
 	w.climate_grid_size = 256
 	w.sub_hourly_tick = 0
 	w.sub_daily_tick = 0
@@ -255,6 +257,7 @@ function world.empty()
 --	print(DCON.get_world_ticks_per_minute(),DCON.get_world_ticks_per_hour(),DCON.get_world_ticks_per_day(),DCON.get_world_ticks_per_month())
 	ffi.C.set_world_current_tick(WORLD.current_tick_in_year)
 	ffi.C.set_world_current_year(WORLD.year)
+	ffi.C.set_world_seed(WORLD.seed)
 end
 
 ---Schedules an event
@@ -76,11 +76,12 @@ function eco_values.get_local_price(province, trade_good)
 end
 
 ---calculates price estimation of unit of use
+---there are no local markets yet, so the estimation uses base prices and is the same in every province
 ---@param province province_id
 ---@param use use_case_id
 ---@return number price
 function eco_values.get_local_price_of_use(province, use)
-    return DCON.estimate_province_use_price(province, use)
+    return DCON.estimate_use_price(use)
 end
 
 ---calculates price estimation of unit of use given a price table
@@ -128,6 +129,42 @@ function eco_values.get_local_price_of_use_with_prices(province, use, prices)
     return total_cost
 end
 
+---compares estimations of the table in c++ with the lua formula for the first and the last use case
+---use case ids from lua are 1-based while the table is indexed from 0,
+---so a mismatch of ids shows up as a different price of one of the ends
+function eco_values.check_use_price_estimation()
+    ---@type table<trade_good_id, number>
+    local base_prices = {}
+    DATA.for_each_trade_good(function (item)
+        base_prices[item] = DATA.trade_good_get_base_price(item)
+    end)
+
+    local first_use = nil
+    local last_use = nil
+    for _, use in pairs(RAWS_MANAGER.use_cases_by_name) do
+        if first_use == nil or use < first_use then
+            first_use = use
+        end
+        if last_use == nil or use > last_use then
+            last_use = use
+        end
+    end
+    if first_use == nil then
+        return
+    end
+
+    for _, use in ipairs({first_use, last_use}) do
+        local expected = eco_values.get_local_price_of_use_with_prices(nil, use, base_prices)
+        local estimated = DCON.estimate_use_price(use)
+        if math.abs(expected - estimated) > 0.001 * math.max(1, math.abs(expected)) then
+            local msg = "Use price estimation of use case " .. tostring(use)
+                .. " is " .. tostring(estimated) .. " instead of " .. tostring(expected)
+            print(msg)
+            error(msg)
+        end
+    end
+end
+
 ---comment
 ---@param province province_id
 ---@param trade_good trade_good_id
@@ -329,6 +329,8 @@ function gam.debug_ui()
 		print("running code!")
 		--Add your code here!
 		plate_gen.run()
+		-- plates move land and elevation of every tile
+		DCON.elevation_refresh()
 		-- Refresh the map mode after loading!
 		gam.refresh_map_mode()
 		print("code finished running!")
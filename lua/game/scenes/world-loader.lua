@@ -254,6 +254,9 @@ function wl.load_save()
 	print(DCON.get_world_ticks_per_minute(),DCON.get_world_ticks_per_hour(),DCON.get_world_ticks_per_day(),DCON.get_world_ticks_per_month())
 	DCON.set_world_current_tick(WORLD.current_tick_in_year)
 	DCON.set_world_current_year(WORLD.year)
+	-- saves from before the seed was kept get a fresh one
+	WORLD.seed = WORLD.seed or love.math.random(1, 2147483647)
+	DCON.set_world_seed(WORLD.seed)
 
 	print("loading options")
 	OPTIONS = require "game.options".load()
@@ -42,6 +42,7 @@ function plate_gen.run()
 		local perlin_variable = (2000 * tile:perlin(20, perlin_seed) ^ 2.5) + 100 -- value of 40 seems best so far
 		tile.elevation = perlin_variable
 		TILE.set_is_land(tile_id, true)
+		DCON.map_mode_mark_tile(tile_id)
 		tile.value_to_overcome = 1
 		tile.expansion_potential = 0
 		tile.already_added = false
@@ -9,9 +9,14 @@ ffi.cdef[[
 	void update_economy();
 
 	void apply_biome(int32_t);
+	void apply_all_biomes(int32_t const* load_order, uint32_t count);
 	void apply_resource(int32_t);
+	void apply_all_resources();
 
-	float estimate_province_use_price(uint32_t, uint32_t);
+	float estimate_use_price(uint32_t use_case_id);
+	float estimate_settlement_use_available(uint32_t settlement_id, uint32_t use_case_id);
+	void update_use_case_table();
+	bool set_sparse_inventory(bool);
 	float estimate_building_type_income(int32_t, int32_t, int32_t, bool);
 	void dcon_everything_write_file(char const* name);
 	void dcon_everything_read_file(char const* name);
@@ -32,6 +37,16 @@ ffi.cdef[[
 	);
 
 	void load_state(char const*);
+	void load_state_without_climate(char const*);
+	void save_state(char const*);
+	void save_state_snapshot(char const*);
+	void wait_for_saves();
+	void set_save_compression(bool);
+	bool save_state_delta(char const*);
+	bool load_state_with_delta(char const* base, char const* delta);
+	bool compact_state(char const* base, char const* delta, char const* output);
+	bool load_world_cache(char const* name, uint64_t fingerprint);
+	bool save_world_cache(char const* name, uint64_t fingerprint);
 	int32_t dcon_reset();
 
 	void update_map_mode_pointer(uint8_t* map, uint32_t world_size);
@@ -39,6 +54,9 @@ ffi.cdef[[
 	void ai_update_price_belief(int32_t trader_raw_id);
 	void ai_trade(int32_t trader_raw_id);
 
+	void set_world_seed(uint64_t seed);
+	uint64_t get_world_seed(void);
+
 	// backend time tracking
 	void set_world_current_year(uint32_t year);
 	uint32_t get_world_current_year(void);
@@ -65,14 +83,23 @@ ffi.cdef[[
 	float pop_warband_time(uint32_t pop,float free);
 	float pop_forage_time(uint32_t pop,float free,float party);
 	float pop_work_time(uint32_t pop,float free,float party,float forage);
+	void pops_time_budget(uint32_t const* pops, uint32_t count, float* free, float* party, float* forage, float* work);
+	void pops_time_budget_all(float* free, float* party, float* forage, float* work);
 	// misc
 	bool pop_same_location(uint32_t pop_a,uint32_t pop_b);
 	bool is_dependent(uint32_t child);
 	bool is_dependent_of(uint32_t child,uint32_t parent);
+	void update_pop_age_cache();
+	void pop_reset_age_cache(uint32_t pop);
 	uint32_t register_text(int32_t text_len, const char* data);
 	uint32_t register_texture(int32_t text_len, const char* data);
 
 	void change_scene(uint8_t scene);
+	void map_mode_mark_tile(uint32_t tile_id);
+	void map_mode_refresh();
+	void elevation_refresh();
+	void map_mode_set_field(uint32_t slot, float const* values);
+	void map_mode_show_field(uint32_t slot, int32_t count, float const* values, float const* colours);
 ]]
 
 if arg and arg[#arg] == "-debug" then
@@ -229,6 +256,8 @@ function sote.load_raws()
 	DEFINES = require "game.defines".init()
 	world.empty()
 	require "game.raws.raws" ()
+	ffi.C.update_use_case_table()
+	require "game.raws.values.economy".check_use_price_estimation()
 end
 
 function sote.load_world()
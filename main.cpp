@@ -11,10 +11,13 @@
 
 #include <string>
 #include <string_view>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <random>
 #include <chrono>
 #include <thread>
@@ -31,6 +34,7 @@
 #include "imgui/backends/imgui_impl_opengl3.h"
 #include "data.hpp"
 #include "frustum.hpp"
+#include "world_loading.hpp"
 #include "unordered_dense.h"
 
 #define DCON_LUADLL_EXPORTS
@@ -81,32 +85,9 @@ glm::vec3 hsv_to_rgb(float h, float s, float v) {
 	return {c + m, 0 + m, x + m};
 }
 
-glm::vec3 rgb_to_hsv(float r, float g, float b) {
-	auto max = std::max(r, std::max(g, b));
-	auto min = std::min(r, std::min(g, b));
-
-	auto h = 0;
-	if (max == min) {
-		h = 0;
-	} else if (max == r) {
-		h = fmod((g - b) * 60 / (max - min), 360.f);
-	} else if (max == g) {
-		h = fmod((b - r) * 60 / (max - min) + 120, 360.f);
-	} else if (max == b) {
-		h = fmod((r - g) * 60 / (max - min) + 240, 360.f);
-	}
-	float s = 0.f;
-	if (max != 0) s = 1 - min / max;
-
-	return {h, s, max};
-}
-
-int rgb_to_id(int r, int g, int b) {
-	return r + 256 * g + 256 * 256 * b;
-}
-
 struct settings {
 	float ui_scale;
+	int shadow_cascades;
 };
 
 namespace game {
@@ -121,17 +102,29 @@ constexpr int WORLD_AREA = WORLD_SIZE * WORLD_SIZE;
 constexpr int WORLD_SIZE_TILES = CHUNK_SIZE * WORLD_SIZE;
 constexpr int WORLD_AREA_TILES = WORLD_SIZE_TILES * WORLD_SIZE_TILES;
 
-struct vertex {
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 texcoord;
-	int face;
+// the planet is drawn as square chunks of cube faces which share one grid of PATCH_SIZE^2 quads,
+// position and elevation of vertices are found in the vertex shader
+constexpr int PATCH_SIZE = 32;
+
+struct patch_vertex {
+	glm::vec2 uv;
+	// skirts hang below the surface along chunk edges and hide cracks between chunks of different detail
+	float skirt;
 };
 
-struct mesh {
-	std::vector<vertex> data;
+struct patch_mesh {
+	GLsizei index_count;
 	GLuint vao;
 	GLuint vbo;
+	GLuint ebo;
+};
+
+// square [s, s + size] x [t, t + size] of a face in face coordinates
+struct terrain_chunk {
+	int face;
+	float s;
+	float t;
+	float size;
 };
 
 struct simple_vertex {
@@ -147,7 +140,13 @@ struct simple_mesh {
 
 struct map_state {
 	// std::array<char, WORLD_AREA_TILES> height {};
-	mesh mesh {};
+	patch_mesh mesh {};
+	std::vector<terrain_chunk> visible_chunks {};
+	std::vector<terrain_chunk> shadow_chunks {};
+	// shadow casters of the cascade being drawn
+	std::vector<terrain_chunk> cascade_chunks {};
+	// lowest and highest surface radius under every chunk of the quadtree, see build_relief_ranges
+	std::vector<std::vector<glm::vec2>> relief {};
 };
 
 constexpr inline uint32_t TEXT_KEY_IS_TEXTURE_PATH = 1;
@@ -166,11 +165,6 @@ struct text_collection {
 
 struct state {
 	map_state map;
-	map_state sky;
-
-	std::default_random_engine rng {};
-	std::uniform_real_distribution<float> uniform{0.0, 1.0};
-	std::normal_distribution<float> normal {0.f, 1.f};
 };
 
 }
@@ -351,290 +345,176 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 	}
 }
 
-namespace cubeworld {
-	namespace top {
-		constexpr glm::vec3 origin = {-1.f, 1.f, -1.f};
-		constexpr glm::vec3 center = {0.f, 1.f, 0.f};
-		constexpr glm::vec3 ds = {2.f, 0.f, 0.f};
-		constexpr glm::vec3 dt = {0.f, 0.f, 2.f};
-		constexpr int face = 0;
-	}
-	namespace bottom {
-		constexpr glm::vec3 origin = {1.f, -1.f, -1.f};
-		constexpr glm::vec3 center = {0.f, -1.f, 0.f};
-		constexpr glm::vec3 ds = {-2.f, 0.f, 0.f};
-		constexpr glm::vec3 dt = {0.f, 0.f, 2.f};
-		constexpr int face = 1;
-	}
-	namespace left {
-		constexpr glm::vec3 origin = {-1.f, 1.f, 1.f};
-		constexpr glm::vec3 center = {-1.f, 0.f, 0.f};
-		constexpr glm::vec3 ds = {0.f, -2.f, 0.f};
-		constexpr glm::vec3 dt = {0.f, 0.f, -2.f};
-		constexpr int face = 2;
-	}
-	namespace right {
-		constexpr glm::vec3 origin = {1.f, -1.f, 1.f};
-		constexpr glm::vec3 center = {1.f, 0.f, 0.f};
-		constexpr glm::vec3 ds = {0.f, 2.f, 0.f};
-		constexpr glm::vec3 dt = {0.f, 0.f, -2.f};
-		constexpr int face = 3;
-	}
-	namespace forward {
-		constexpr glm::vec3 origin = {-1.f, -1.f, 1.f};
-		constexpr glm::vec3 center = {0.f, 0.f, 1.f};
-		constexpr glm::vec3 ds = {0.f, 2.f, 0.f};
-		constexpr glm::vec3 dt = {2.f, 0.f, 0.f};
-		constexpr int face = 4;
-	}
-	namespace back {
-		constexpr glm::vec3 origin = {1.f, -1.f, -1.f};
-		constexpr glm::vec3 center = {0.f, 0.f, -1.f};
-		constexpr glm::vec3 ds = {0.f, 2.f, 0.f};
-		constexpr glm::vec3 dt = {-2.f, 0.f, 0.f};
-		constexpr int face = 5;
-	}
-}
-
-constexpr glm::vec3 face_to_center[6] {
-	cubeworld::top::center,
-	cubeworld::bottom::center,
-	cubeworld::left::center,
-	cubeworld::right::center,
-	cubeworld::forward::center,
-	cubeworld::back::center,
-};
-constexpr glm::vec3 face_to_origin[6] {
-	cubeworld::top::origin,
-	cubeworld::bottom::origin,
-	cubeworld::left::origin,
-	cubeworld::right::origin,
-	cubeworld::forward::origin,
-	cubeworld::back::origin,
-};
-constexpr glm::vec3 face_to_ds[6] {
-	cubeworld::top::ds,
-	cubeworld::bottom::ds,
-	cubeworld::left::ds,
-	cubeworld::right::ds,
-	cubeworld::forward::ds,
-	cubeworld::back::ds,
-};
-constexpr glm::vec3 face_to_dt[6] {
-	cubeworld::top::dt,
-	cubeworld::bottom::dt,
-	cubeworld::left::dt,
-	cubeworld::right::dt,
-	cubeworld::forward::dt,
-	cubeworld::back::dt,
-};
+float opengl_elevation(float elevation) {
+	return (elevation + 32000.f * 2.f) / 32000.f / 2.f;
+}
 
-glm::vec3 fst_to_sphere(int world_size, glm::ivec3 fst) {
-	int f =fst.x;
-	int s = fst.y;
-	int t = fst.z;
-	auto fs = (float(s) + 0.5f) / float(world_size);
-	auto ft = (float(t) + 0.5f) / float(world_size);
-	glm::vec3 ds;
-	glm::vec3 dt;
-	glm::vec3 origin;
-	if (f == 0) {
-		origin = cubeworld::top::origin;
-		dt = cubeworld::top::dt;
-		ds = cubeworld::top::ds;
-	} else if (f == 1) {
-		origin = cubeworld::bottom::origin;
-		dt = cubeworld::bottom::dt;
-		ds = cubeworld::bottom::ds;
-	} else if (f == 2) {
-		origin = cubeworld::left::origin;
-		dt = cubeworld::left::dt;
-		ds = cubeworld::left::ds;
-	} else if (f == 3) {
-		origin = cubeworld::right::origin;
-		dt = cubeworld::right::dt;
-		ds = cubeworld::right::ds;
-	} else if (f == 4) {
-		origin = cubeworld::forward::origin;
-		dt = cubeworld::forward::dt;
-		ds = cubeworld::forward::ds;
-	} else if (f == 5) {
-		origin = cubeworld::back::origin;
-		dt = cubeworld::back::dt;
-		ds = cubeworld::back::ds;
-	} else {
-		assert(false);
-		exit(1);
+void generate_patch(game::patch_mesh& mesh) {
+	constexpr int N = game::PATCH_SIZE;
+	const float Nf = (float) N;
+
+	std::vector<game::patch_vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	for (int is = 0; is <= N; is++) {
+		for (int it = 0; it <= N; it++) {
+			vertices.push_back({{(float)(is) / Nf, (float)(it) / Nf}, 0.f});
+		}
 	}
 
-	auto result = (origin + ds * fs + dt * ft);
+	auto vertex = [&](int is, int it) {
+		return (uint32_t)(is * (N + 1) + it);
+	};
 
-	return result / glm::length(result);
-}
+	for (int is = 0; is < N; is++) {
+		for (int it = 0; it < N; it++) {
+			indices.push_back(vertex(is, it));
+			indices.push_back(vertex(is, it + 1));
+			indices.push_back(vertex(is + 1, it));
 
-uint8_t sphere_to_face(glm::vec3 point) {
-	// we do it the most stupid way possible: find the closest +- basis vector
-	auto best_distance = 3.f;
-	auto best_face = 0;
-	for (int face = 0; face < 6; ++face) {
-		auto distance = glm::distance(point, face_to_center[face]);
-		if (distance < best_distance) {
-			best_face = face;
-			best_distance = distance;
+			indices.push_back(vertex(is + 1, it));
+			indices.push_back(vertex(is, it + 1));
+			indices.push_back(vertex(is + 1, it + 1));
 		}
 	}
-	return best_face;
-}
 
-glm::vec3 sphere_to_box(glm::vec3 point) {
-	auto face = sphere_to_face(point / glm::length(point));
-	auto center = face_to_center[face];
-	// move back to cube:
-	auto value = glm::dot(center, point);
-	auto box_side = point / value;
-	return box_side;
-}
+	// border of the grid in order, every border vertex gets a copy in the skirt
+	std::vector<uint32_t> border;
+	for (int i = 0; i < N; i++) border.push_back(vertex(i, 0));
+	for (int i = 0; i < N; i++) border.push_back(vertex(N, i));
+	for (int i = N; i > 0; i--) border.push_back(vertex(i, N));
+	for (int i = N; i > 0; i--) border.push_back(vertex(0, i));
 
+	auto skirt_start = (uint32_t)vertices.size();
+	for (auto index : border) {
+		vertices.push_back({vertices[index].uv, 1.f});
+	}
 
+	// skirts are seen from both sides depending on the face, so both windings are emitted
+	auto count = (uint32_t)border.size();
+	for (uint32_t i = 0; i < count; i++) {
+		auto a = border[i];
+		auto b = border[(i + 1) % count];
+		auto a_skirt = skirt_start + i;
+		auto b_skirt = skirt_start + (i + 1) % count;
 
-glm::ivec3 sphere_to_fst(int world_size, glm::vec3 point) {
-	auto face = sphere_to_face(point / glm::length(point));
-	auto center = face_to_center[face];
-	// move back to cube:
-	auto value = glm::dot(center, point);
-	auto box_side = point / value;
-	auto ratio = (box_side - face_to_origin[face]);
-	auto dual_dt = face_to_dt[face] / glm::dot(face_to_dt[face], face_to_dt[face]);
-	auto dual_ds = face_to_ds[face] / glm::dot(face_to_ds[face], face_to_ds[face]);
-	auto t = std::max(0.f, glm::dot(ratio, dual_dt) - 0.00001f) * world_size;
-	auto s = std::max(0.f, glm::dot(ratio, dual_ds) - 0.00001f) * world_size;
-	return {face, (int)(s), (int)(t)};
-}
+		indices.insert(indices.end(), {a, b, a_skirt, a_skirt, b, b_skirt});
+		indices.insert(indices.end(), {a, a_skirt, b, a_skirt, b_skirt, b});
+	}
 
-dcon::tile_id fst_to_tile(int world_size, glm::ivec3 fst ) {
-	return dcon::tile_id {(uint32_t) fst.x * world_size * world_size + fst.z * world_size + fst.y};
-}
+	GLuint vbo;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(game::patch_vertex), vertices.data(), GL_STATIC_DRAW);
 
-dcon::tile_id r3_to_tile(int world_size, glm::vec3 point) {
-	auto fst = sphere_to_fst(world_size, point / glm::length(point));
-	return fst_to_tile(world_size, fst);
-}
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	GLuint ebo;
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(game::patch_vertex),  reinterpret_cast<void*>(offsetof(game::patch_vertex, uv)));
 
-glm::ivec3 tile_to_fst(int world_size, dcon::tile_id tile) {
-	auto index = tile.index();
-	auto face_size = world_size * world_size;
-	auto face = index / face_size;
-	auto st = index - face * face_size;
-	auto t = st / world_size;
-	auto s = st - t * world_size;
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(game::patch_vertex),  reinterpret_cast<void*>(offsetof(game::patch_vertex, skirt)));
 
-	return {face, s, t};
+	glBindVertexArray(0);
+
+	mesh.index_count = (GLsizei)indices.size();
+	mesh.vao = vao;
+	mesh.vbo = vbo;
+	mesh.ebo = ebo;
 }
 
-glm::vec3 tile_to_sphere(int world_size, dcon::tile_id tile) {
-	auto index = tile.index();
-	auto face_size = world_size * world_size;
-	auto face = index / face_size;
-	auto st = index - face * face_size;
-	auto t = st / world_size;
-	auto s = st - t * world_size;
-	return fst_to_sphere(world_size, {face, s, t});
+// number of times a face is split until a quad of the patch covers a single tile
+int chunk_levels(int world_size) {
+	int level = 0;
+	while ((game::PATCH_SIZE << level) < world_size) {
+		level++;
+	}
+	return level;
 }
 
+// relief above and below sea level in units of planet radius, see opengl_elevation
+constexpr float max_relief = 0.15f;
+// chunks are split while the camera is closer than this many chunk sizes
+constexpr float chunk_split_distance = 3.f;
 
-glm::vec2 sphere_to_rect(glm::vec3 point) {
-	auto d = glm::length(point);
-	auto y = acosf(point.y / d);
-	auto x = atan2f(point.z, point.x);
-	glm::vec2 res = {  x + glm::pi<float>() , y};
-	glm::vec2 scaling = { glm::pi<float>() * 2, glm::pi<float>()};
-	return res / scaling;
+glm::vec3 chunk_point(game::terrain_chunk const& chunk, float u, float v) {
+	return face_to_origin[chunk.face]
+		+ (chunk.s + u * chunk.size) * face_to_ds[chunk.face]
+		+ (chunk.t + v * chunk.size) * face_to_dt[chunk.face];
 }
 
-int rect_to_image_index(int width, int height, glm::vec2 point) {
-	int x = (int)((float)width * point.x);
-	int y = (int)((float)height * point.y);
-	return width * y + x;
+glm::vec3 chunk_center(game::terrain_chunk const& chunk) {
+	return glm::normalize(chunk_point(chunk, 0.5f, 0.5f));
 }
 
-float opengl_elevation(float elevation) {
-	return (elevation + 32000.f * 2.f) / 32000.f / 2.f;
+// half diagonal of the chunk on the cube, projection to the sphere only shrinks it
+float chunk_extent(game::terrain_chunk const& chunk) {
+	return chunk.size * glm::root_two<float>();
 }
 
-void push_face_vertices(dcon::data_container& state, game::map_state& data, int world_size, glm::vec3 origin, glm::vec3 ds, glm::vec3 dt, uint8_t face, bool fake) {
-	auto& mesh = data.mesh.data;
-
-	int N = 256;
-	if (fake) {
-		N = 64;
+void cull_chunks(
+	std::vector<game::terrain_chunk> const& chunks,
+	frustum const& view,
+	std::vector<game::terrain_chunk>& result
+) {
+	result.clear();
+	for (auto& chunk : chunks) {
+		if (view.intersects(chunk_center(chunk), chunk_extent(chunk) + max_relief)) {
+			result.push_back(chunk);
+		}
 	}
-	const float Nf = (float) N;
-	for (int is = 0; is < N; is++) {
-		for (int it = 0; it < N; it++) {
-
-			auto current_s = (float)(is) / Nf;
-			auto current_t = (float)(it) / Nf;
-
-			auto next_s = current_s + 1.f / Nf;
-			auto next_t = current_t + 1.f / Nf;
-
-
-			auto s_current_ds = current_s * ds;
-			auto s_current_dt = current_t * dt;
-
-			auto s_next_ds = 1.f / Nf * ds;
-			auto s_next_dt = 1.f / Nf * dt;
-
-			auto current_origin = origin + s_current_ds + s_current_dt;
-
-			auto minor_shift = glm::vec3(0.00f, 0.00f, 0.00f);
-
-			auto p00 = (current_origin) / glm::length(current_origin);
-			auto p01 = (current_origin + s_next_dt) / glm::length(current_origin + s_next_dt);
-			auto p10 = (current_origin + s_next_ds) / glm::length(current_origin + s_next_ds);
-			auto p11 = (current_origin + s_next_dt + s_next_ds) / glm::length(current_origin + s_next_dt + s_next_ds);
-
-			auto tile00 = r3_to_tile(world_size, p00 + minor_shift);
-			auto tile01 = r3_to_tile(world_size, p01 + minor_shift);
-			auto tile10 = r3_to_tile(world_size, p10 + minor_shift);
-			auto tile11 = r3_to_tile(world_size, p11 + minor_shift);
-
-			auto location = tile_to_sphere(world_size, tile00);
-			auto distance = glm::distance(p00, location);
-			assert(distance < 4.f / (float)world_size);
-
-
-			if (fake) {
-				p00 *= 1.5f;
-				p01 *= 1.5f;
-				p10 *= 1.5f;
-				p11 *= 1.5f;
-			} else {
-				auto elevation00 = opengl_elevation(state.tile_get_elevation(tile00));
-				auto elevation01 = opengl_elevation(state.tile_get_elevation(tile01));
-				auto elevation10 = opengl_elevation(state.tile_get_elevation(tile10));
-				auto elevation11 = opengl_elevation(state.tile_get_elevation(tile11));
-				p00 *= elevation00;
-				p01 *= elevation01;
-				p10 *= elevation10;
-				p11 *= elevation11;
-			}
-
-
-			auto normal1 = glm::normalize(glm::cross(p01 - p00, p10 - p00));
-
-			mesh.push_back({p00, normal1, {current_s, current_t}, face});
-			mesh.push_back({p01, normal1, {current_s, next_t}, face});
-			mesh.push_back({p10, normal1, {next_s, current_t}, face});
-
-			auto normal2 = glm::normalize(glm::cross(p01 - p10, p11 - p10));
+}
 
-			mesh.push_back({p10, normal2, {next_s, current_t}, face});
-			mesh.push_back({p01, normal2, {current_s, next_t}, face});
-			mesh.push_back({p11, normal2, {next_s, next_t}, face});
+// quadtree over every face: chunks behind the horizon or outside of the view are dropped,
+// chunks close to the eye are split until they reach tile resolution
+void select_chunks(
+	std::vector<game::terrain_chunk>& result,
+	glm::vec3 eye,
+	int max_level,
+	frustum const* view
+) {
+	result.clear();
+
+	auto eye_distance = glm::length(eye);
+	auto eye_direction = eye / eye_distance;
+	// angle from the eye direction to the farthest visible point of the highest mountain
+	auto horizon = glm::pi<float>();
+	if (eye_distance > 1.f) {
+		horizon = acosf(1.f / eye_distance) + acosf(1.f / (1.f + max_relief));
+	}
+
+	auto visit = [&](auto&& visit, game::terrain_chunk chunk, int level) -> void {
+		auto center = chunk_center(chunk);
+		auto extent = chunk_extent(chunk);
+		auto radius = extent + max_relief;
+
+		auto angle = acosf(std::clamp(glm::dot(center, eye_direction), -1.f, 1.f));
+		if (angle - extent > horizon) return;
+		if (view && !view->intersects(center, radius)) return;
+
+		auto distance = glm::distance(eye, center) - radius;
+		if (level < max_level && distance < chunk_split_distance * chunk.size) {
+			auto half = chunk.size / 2.f;
+			visit(visit, {chunk.face, chunk.s, chunk.t, half}, level + 1);
+			visit(visit, {chunk.face, chunk.s + half, chunk.t, half}, level + 1);
+			visit(visit, {chunk.face, chunk.s, chunk.t + half, half}, level + 1);
+			visit(visit, {chunk.face, chunk.s + half, chunk.t + half, half}, level + 1);
+			return;
 		}
-	}
+		result.push_back(chunk);
+	};
 
+	for (int face = 0; face < 6; face++) {
+		visit(visit, {face, 0.f, 0.f, 1.f}, 0);
+	}
 }
 
 void generate_square(game::simple_mesh& mesh) {
@@ -666,78 +546,6 @@ void generate_square(game::simple_mesh& mesh) {
 	mesh.vbo = vbo;
 }
 
-void generate_cube_sphere(dcon::data_container& state,  game::map_state& data, int world_size, bool fake) {
-	push_face_vertices(
-		state, data, world_size,
-		cubeworld::back::origin,
-		cubeworld::back::ds,
-		cubeworld::back::dt,
-		cubeworld::back::face, fake
-	);
-	push_face_vertices(
-		state, data, world_size,
-		cubeworld::forward::origin,
-		cubeworld::forward::ds,
-		cubeworld::forward::dt,
-		cubeworld::forward::face, fake
-	);
-	push_face_vertices(
-		state, data, world_size,
-		cubeworld::left::origin,
-		cubeworld::left::ds,
-		cubeworld::left::dt,
-		cubeworld::left::face, fake
-	);
-	push_face_vertices(
-		state, data, world_size,
-		cubeworld::right::origin,
-		cubeworld::right::ds,
-		cubeworld::right::dt,
-		cubeworld::right::face, fake
-	);
-	push_face_vertices(
-		state, data, world_size,
-		cubeworld::top::origin,
-		cubeworld::top::ds,
-		cubeworld::top::dt,
-		cubeworld::top::face, fake
-	);
-	push_face_vertices(
-		state, data, world_size,
-		cubeworld::bottom::origin,
-		cubeworld::bottom::ds,
-		cubeworld::bottom::dt,
-		cubeworld::bottom::face, fake
-	);
-
-	auto& mesh = data.mesh.data;
-
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(game::vertex), mesh.data(), GL_STATIC_DRAW);
-
-	GLuint vao;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(game::vertex),  reinterpret_cast<void*>(0));
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(game::vertex),  reinterpret_cast<void*>(sizeof(float) * 3));
-
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(game::vertex),  reinterpret_cast<void*>(sizeof(float) * 3 + sizeof(float) * 3));
-
-	glEnableVertexAttribArray(3);
-	glVertexAttribIPointer(3, 1, GL_INT, sizeof(game::vertex),  reinterpret_cast<void*>(sizeof(float) * 3 + sizeof(float) * 3 + sizeof(float) * 2));
-
-	data.mesh.vao = vao;
-	data.mesh.vbo = vbo;
-}
-
 namespace geometry {
 
 namespace screen_relative {
@@ -768,64 +576,6 @@ point convert(const geometry::world::point in, const geometry::world::point came
 }
 
 
-bool color_is_land(uint8_t r, uint8_t g, uint8_t b) {
-	if (r == 30 && g == 125 && b == 255) {
-		return false;
-	}
-	if (r == 15 && g == 239 && b == 255) {
-		return false;
-	}
-	if (r == 2 && g == 8 && b == 209) {
-		return false;
-	}
-	return true;
-}
-
-bool color_is_fresh(uint8_t r, uint8_t g, uint8_t b) {
-	if (r == 15 && g == 239 && b == 255) {
-		return true;
-	}
-	return false;
-}
-
-bool equals(uint8_t r, uint8_t g, uint8_t b, uint8_t r1, uint8_t g1, uint8_t b1) {
-	return r == r1 && g == g1 && b == b1;
-}
-
-float color_waterflow(uint8_t r, uint8_t g, uint8_t b) {
-	if (r == 30 && g == 125 && b == 255) {
-		return 0.f;
-	}
-	if (r == 15 && g == 239 && b == 255) {
-		return 0.f;
-	}
-	if (r == 2 && g == 8 && b == 209) {
-		return 0.f;
-	}
-	if (equals(r, g, b, 129, 9, 9)) {
-		return 0.f;
-	}
-	if (equals(r, g, b, 244, 17, 17)) {
-		return 800;
-	}
-	if (equals(r, g, b, 255, 132, 17)) {
-		return 2000;
-	}
-	if (equals(r, g, b, 250, 250, 10)) {
-		return 5259;
-	}
-	if (equals(r, g, b, 28, 255, 122)) {
-		return 11250;
-	}
-	if (equals(r, g, b, 15, 175, 255)) {
-		return 20000;
-	}
-	if (equals(r, g, b, 24, 77, 249)) {
-		return 30000;
-	}
-	return 0.f;
-}
-
 struct shader_2d_data {
 	GLuint shift;
 	GLuint zoom;
@@ -1300,9 +1050,340 @@ void race_explorer(const float TEXT_BASE_HEIGHT) {
 }
 
 static bool requested_map_update = false;
+// map mode whose palette is in the uniform buffer, -1 when it has to be uploaded again
+static int map_mode_loaded = -1;
+// tiles changed since the last upload: rectangle s0, t0, s1, t1 of every face, empty when s0 >= s1
+static std::array<glm::ivec4, 6> map_mode_dirty {};
+static int map_mode_world_size = 1;
+
+void dirty_map_mode_tile(dcon::tile_id tile) {
+	auto fst = tile_to_fst(map_mode_world_size, tile);
+	auto& rect = map_mode_dirty[fst.x];
+	if (rect.x >= rect.z) {
+		rect = {fst.y, fst.z, fst.y + 1, fst.z + 1};
+	} else {
+		rect = {
+			std::min(rect.x, fst.y), std::min(rect.y, fst.z),
+			std::max(rect.z, fst.y + 1), std::max(rect.w, fst.z + 1)
+		};
+	}
+}
+
+// raw fields of tiles kept on the gpu, map modes colour them in the planet shader:
+// scalars go through a colour ramp, indices of objects pick a colour from a palette
+enum class map_field : uint8_t {
+	elevation,
+	soil_organics,
+	ice,
+	ice_age_ice,
+	january_waterflow,
+	july_waterflow,
+	coast,
+	land,
+	vegetation,
+	plate,
+	bedrock,
+	biome,
+	count
+};
+constexpr int map_scalar_fields = (int)map_field::plate;
+constexpr int map_index_fields = (int)map_field::count - map_scalar_fields;
+// scalar layers after the built in ones are filled from lua
+constexpr int map_lua_fields = 4;
+
+enum class map_mode_kind : int32_t {
+	ramp = 0,
+	palette = 1,
+};
+
+constexpr int MAP_MODE_PALETTE_SIZE = 512;
+constexpr int MAP_MODE_RAMP_SIZE = 16;
+
+// std140 mirror of the map_mode block in basic_shader_meshes.frag
+struct map_mode_palette {
+	// colours of ramp stops, or colours of objects by index + 1
+	glm::vec4 colours[MAP_MODE_PALETTE_SIZE];
+	// x is the field value of the ramp stop
+	glm::vec4 stops[MAP_MODE_RAMP_SIZE];
+	// field layer, kind, number of ramp stops
+	glm::ivec4 mode;
+};
+
+map_mode_palette ramp_map_mode(int layer, std::initializer_list<std::pair<float, glm::vec3>> stops) {
+	map_mode_palette result {};
+	int i = 0;
+	for (auto& [value, colour] : stops) {
+		result.colours[i] = glm::vec4(colour, 1.f);
+		result.stops[i].x = value;
+		i++;
+	}
+	result.mode = {layer, (int)map_mode_kind::ramp, i, 0};
+	return result;
+}
+
+// the first slot is for tiles without an object, objects past the palette share its last colour
+template<typename F>
+map_mode_palette palette_map_mode(int layer, uint32_t count, F&& colour) {
+	map_mode_palette result {};
+	// palettes are built again on every full refresh, so each overflow is reported once
+	static std::array<uint32_t, map_index_fields> reported {};
+	if (count + 1 > MAP_MODE_PALETTE_SIZE && reported[layer] != count) {
+		reported[layer] = count;
+		auto message = "Map mode has " + std::to_string(count) + " objects, only "
+			+ std::to_string(MAP_MODE_PALETTE_SIZE - 1) + " have their own colour";
+		window::emit_error_message(message, false);
+		fprintf(stderr, "%s\n", message.c_str());
+	}
+	for (uint32_t i = 0; i < count && i + 1 < MAP_MODE_PALETTE_SIZE; i++) {
+		result.colours[i + 1] = glm::vec4(colour(i), 1.f);
+	}
+	result.mode = {layer, (int)map_mode_kind::palette, 0, 0};
+	return result;
+}
+
+// map mode requested from lua: a field filled by map_mode_set_field with a ramp
+static bool lua_map_mode_requested = false;
+// the lua map mode stays shown until another mode is picked, also when palettes are uploaded again
+static bool lua_map_mode_active = false;
+static map_mode_palette lua_map_mode {};
+// values of lua fields waiting for upload, empty when there is nothing new
+static std::array<std::vector<float>, map_lua_fields> lua_map_fields {};
+
+// field texels are written by worker threads straight into a pixel buffer
+// and copied into the textures by the driver;
+// the buffer has two regions, so filling one doesn't wait for the copy from the other
+struct map_mode_stream {
+	GLuint scalar_texture;
+	GLuint index_texture;
+	GLuint palette_buffer;
+	GLuint pbo;
+	int world_size;
+	size_t region_size;
+	int region;
+	// mapped once for the lifetime of the buffer when persistent mapping is available
+	uint8_t* persistent;
+	std::array<GLsync, 2> fences;
+};
 
-template <typename F>
-void map_modes(std::vector<uint8_t>& map_mode_data, int world_size, F&& commit_map_mode) {
+GLuint create_field_texture(GLenum format, int world_size, int fields) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, format, world_size, world_size, fields * map_mode_layers);
+	return texture;
+}
+
+void create_map_mode_stream(map_mode_stream& stream, int world_size) {
+	for (auto& fence : stream.fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (stream.pbo) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream.pbo);
+		if (stream.persistent) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &stream.pbo);
+	}
+	if (stream.scalar_texture) glDeleteTextures(1, &stream.scalar_texture);
+	if (stream.index_texture) glDeleteTextures(1, &stream.index_texture);
+	if (stream.palette_buffer) glDeleteBuffers(1, &stream.palette_buffer);
+
+	stream.world_size = world_size;
+	map_mode_world_size = world_size;
+	// one field: four bytes for every tile
+	stream.region_size = 4 * (size_t)map_mode_layers * world_size * world_size;
+	stream.region = 0;
+	stream.persistent = nullptr;
+
+	stream.scalar_texture = create_field_texture(GL_R16F, world_size, map_scalar_fields + map_lua_fields);
+	stream.index_texture = create_field_texture(GL_R16UI, world_size, map_index_fields);
+
+	glGenBuffers(1, &stream.palette_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, stream.palette_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(map_mode_palette), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glGenBuffers(1, &stream.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream.pbo);
+	if (GLEW_ARB_buffer_storage) {
+		auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, 2 * stream.region_size, nullptr, flags);
+		stream.persistent = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, 2 * stream.region_size, flags);
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, 2 * stream.region_size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	map_mode_dirty.fill(glm::ivec4{0});
+	requested_map_update = true;
+	map_mode_loaded = -1;
+	// lua fields of the old world are gone with the textures
+	lua_map_mode_active = false;
+}
+
+// texel of a tile is at its index: face * world_size^2 + t * world_size + s
+template<typename T>
+void write_map_field(uint8_t* data, map_field field, T tiles) {
+	auto scalar = [&](ve::fp_vector values) {
+		ve::apply([&](dcon::tile_id tile, float value) {
+			std::memcpy(data + 4 * tile.index(), &value, sizeof(value));
+		}, tiles, values);
+	};
+	// index + 1 of the object, 0 when there is none
+	auto index = [&](auto ids) {
+		ve::apply([&](dcon::tile_id tile, auto id) {
+			uint32_t value = (uint32_t)(id.index() + 1);
+			std::memcpy(data + 4 * tile.index(), &value, sizeof(value));
+		}, tiles, ids);
+	};
+
+	switch (field) {
+	case map_field::elevation: scalar(state.tile_get_elevation(tiles)); break;
+	case map_field::soil_organics: scalar(state.tile_get_soil_organics(tiles)); break;
+	case map_field::ice: scalar(state.tile_get_ice(tiles)); break;
+	case map_field::ice_age_ice: scalar(state.tile_get_ice_age_ice(tiles)); break;
+	case map_field::january_waterflow: scalar(state.tile_get_january_waterflow(tiles)); break;
+	case map_field::july_waterflow: scalar(state.tile_get_july_waterflow(tiles)); break;
+	case map_field::coast:
+		scalar(ve::select(state.tile_get_is_coast(tiles), ve::fp_vector{1.f}, ve::fp_vector{0.f}));
+		break;
+	case map_field::land:
+		scalar(ve::select(state.tile_get_is_land(tiles), ve::fp_vector{1.f}, ve::fp_vector{0.f}));
+		break;
+	case map_field::vegetation:
+		scalar(
+			state.tile_get_conifer(tiles) + state.tile_get_broadleaf(tiles)
+			+ state.tile_get_shrub(tiles) + state.tile_get_grass(tiles)
+		);
+		break;
+	case map_field::plate: index(state.tile_get_plate_from_plate_tiles(tiles)); break;
+	case map_field::bedrock: index(state.tile_get_bedrock(tiles)); break;
+	case map_field::biome: index(state.tile_get_biome(tiles)); break;
+	case map_field::count: break;
+	}
+}
+
+// fills the next region of the buffer with one field through write(data, tiles)
+// and copies the whole field, or only the given rectangles, into its layers of the texture
+template<typename F>
+void stream_map_field(
+	map_mode_stream& stream,
+	GLuint texture, int field_layer, GLenum format, GLenum type,
+	std::array<glm::ivec4, 6> const* rects,
+	F&& write
+) {
+	auto world_size = stream.world_size;
+
+	auto& fence = stream.fences[stream.region];
+	if (fence) {
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	auto offset = stream.region * stream.region_size;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream.pbo);
+	uint8_t* data = stream.persistent
+		? stream.persistent + offset
+		: (uint8_t*)glMapBufferRange(
+			GL_PIXEL_UNPACK_BUFFER, offset, stream.region_size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+		);
+
+	// the last vector is partial: padding lanes past the tiles would write past the region
+	auto count = state.tile_size();
+	auto write_vector = [&](uint32_t base) {
+		if (base + ve::vector_size <= count) {
+			write(data, ve::contiguous_tags<dcon::tile_id>(base));
+		} else {
+			write(data, ve::partial_contiguous_tags<dcon::tile_id>(base, count - base));
+		}
+	};
+
+	if (!rects) {
+		auto vectors = (count + ve::vector_size - 1) / ve::vector_size;
+		concurrency::parallel_for(uint32_t(0), (uint32_t)vectors, [&](auto i) {
+			write_vector((uint32_t)(i * ve::vector_size));
+		});
+	} else {
+		// rows of rectangles are contiguous ranges of tiles: they are covered by whole vectors,
+		// and a vector shared by two rows is written once
+		std::vector<uint32_t> vectors;
+		for (int face = 0; face < map_mode_layers; face++) {
+			auto& rect = (*rects)[face];
+			for (int t = rect.y; t < rect.w && rect.x < rect.z; t++) {
+				auto row = (uint32_t)(face * world_size * world_size + t * world_size);
+				auto first = (row + rect.x) / ve::vector_size * ve::vector_size;
+				for (auto base = first; base < row + rect.z; base += ve::vector_size) {
+					if (vectors.empty() || vectors.back() != base) {
+						vectors.push_back(base);
+					}
+				}
+			}
+		}
+		concurrency::parallel_for(uint32_t(0), (uint32_t)vectors.size(), [&](auto i) {
+			write_vector(vectors[i]);
+		});
+	}
+
+	if (!stream.persistent) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	auto first_layer = field_layer * map_mode_layers;
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	if (!rects) {
+		glTexSubImage3D(
+			GL_TEXTURE_2D_ARRAY, 0,
+			0, 0, first_layer,
+			world_size, world_size, map_mode_layers,
+			format, type, reinterpret_cast<void*>(offset)
+		);
+	} else {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, world_size);
+		for (int face = 0; face < map_mode_layers; face++) {
+			auto& rect = (*rects)[face];
+			if (rect.x >= rect.z) continue;
+			auto start = offset + 4 * ((size_t)face * world_size * world_size + rect.y * world_size + rect.x);
+			glTexSubImage3D(
+				GL_TEXTURE_2D_ARRAY, 0,
+				rect.x, rect.y, first_layer + face,
+				rect.z - rect.x, rect.w - rect.y, 1,
+				format, type, reinterpret_cast<void*>(start)
+			);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stream.region = 1 - stream.region;
+}
+
+void stream_built_in_field(map_mode_stream& stream, map_field field, std::array<glm::ivec4, 6> const* rects) {
+	auto write = [field](uint8_t* data, auto tiles) {
+		write_map_field(data, field, tiles);
+	};
+	auto i = (int)field;
+	if (i < map_scalar_fields) {
+		stream_map_field(stream, stream.scalar_texture, i, GL_RED, GL_FLOAT, rects, write);
+	} else {
+		stream_map_field(stream, stream.index_texture, i - map_scalar_fields, GL_RED_INTEGER, GL_UNSIGNED_INT, rects, write);
+	}
+}
+
+// every built in field, or only their dirty rectangles
+void stream_map_fields(map_mode_stream& stream, std::array<glm::ivec4, 6> const* rects) {
+	for (int i = 0; i < (int)map_field::count; i++) {
+		stream_built_in_field(stream, (map_field)i, rects);
+	}
+}
+
+void map_modes(map_mode_stream& stream) {
 	ImGui::Begin("Map mode");
 	const char* items[] = {
 		"White",
@@ -1315,11 +1396,11 @@ void map_modes(std::vector<uint8_t>& map_mode_data, int world_size, F&& commit_m
 		"Soil organics",
 		"Ice",
 		"Rocks",
-		"Biomes"
+		"Biomes",
+		"Vegetation"
 	};
 
 	static int item_selected_idx = 0;
-	static int loaded_idx = -1;
 	static bool item_highlight = false;
 
 	// Custom size: use all width, 5 items tall
@@ -1330,8 +1411,12 @@ void map_modes(std::vector<uint8_t>& map_mode_data, int world_size, F&& commit_m
 	)) {
 		for (int n = 0; n < IM_ARRAYSIZE(items); n++) {
 			bool is_selected = (item_selected_idx == n);
-			if (ImGui::Selectable(items[n], is_selected, 0))
+			if (ImGui::Selectable(items[n], is_selected, 0)) {
 				item_selected_idx = n;
+				// picking the shown mode again also replaces a lua map mode
+				lua_map_mode_active = false;
+				map_mode_loaded = -1;
+			}
 			if (is_selected)
 				ImGui::SetItemDefaultFocus();
 		}
@@ -1341,154 +1426,188 @@ void map_modes(std::vector<uint8_t>& map_mode_data, int world_size, F&& commit_m
 	static bool ice_age = false;
 	if (item_selected_idx == 8) {
 		if (ImGui::Checkbox("Ice age?", &ice_age)) {
-			requested_map_update = true;
+			map_mode_loaded = -1;
+			lua_map_mode_active = false;
 		}
 	}
 
 	ImGui::End();
 
+	// tiles changed by the simulation or by lua
+	static std::vector<dcon::tile_id> changed_tiles;
+	if (take_map_mode_changes(changed_tiles)) {
+		requested_map_update = true;
+	} else {
+		for (auto tile : changed_tiles) {
+			dirty_map_mode_tile(tile);
+		}
+	}
 
-	if (item_selected_idx != loaded_idx || requested_map_update) {
-		loaded_idx = item_selected_idx;
+	// fields are uploaded once, later only tiles which changed
+	if (requested_map_update) {
 		requested_map_update = false;
-		if (item_selected_idx == 0) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				map_mode_data[4 * index + 0] = 255;
-				map_mode_data[4 * index + 1] = 255;
-				map_mode_data[4 * index + 2] = 255;
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 1) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				if (state.tile_get_is_coast(tile)) {
-					map_mode_data[4 * index + 0] = 0;
-					map_mode_data[4 * index + 1] = 0;
-					map_mode_data[4 * index + 2] = 0;
-					map_mode_data[4 * index + 3] = 255;
-				} else {
-					map_mode_data[4 * index + 0] = 255;
-					map_mode_data[4 * index + 1] = 255;
-					map_mode_data[4 * index + 2] = 255;
-					map_mode_data[4 * index + 3] = 255;
-				}
-			});
-		} else if (item_selected_idx == 2) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto plate = state.tile_get_plate_from_plate_tiles(tile);
-				auto fst = tile_to_fst(world_size, tile);
-				auto r = state.plate_get_r(plate);
-				auto g = state.plate_get_g(plate);
-				auto b = state.plate_get_b(plate);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				map_mode_data[4 * index + 0] = (uint8_t)(r * 255);
-				map_mode_data[4 * index + 1] = (uint8_t)(g * 255);
-				map_mode_data[4 * index + 2] = (uint8_t)(b * 255);
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 3) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto waterflow = state.tile_get_january_waterflow(tile);
-				map_mode_data[4 * index + 0] = (255 - (uint8_t)(waterflow / 20000.f * 255)) / 10;
-				map_mode_data[4 * index + 1] = 0;
-				map_mode_data[4 * index + 2] = (uint8_t)(waterflow / 20000.f * 255);
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 4) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto waterflow = state.tile_get_july_waterflow(tile);
-				map_mode_data[4 * index + 0] = (255 - (uint8_t)(waterflow / 20000.f * 255)) / 10;
-				map_mode_data[4 * index + 1] = 0;
-				map_mode_data[4 * index + 2] = (uint8_t)(waterflow / 20000.f * 255);
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 5) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				if (!state.tile_get_is_land(tile)) {
-					map_mode_data[4 * index + 0] = 0;
-					map_mode_data[4 * index + 1] = 0;
-					map_mode_data[4 * index + 2] = 0;
-					map_mode_data[4 * index + 3] = 255;
-				} else {
-					map_mode_data[4 * index + 0] = 255;
-					map_mode_data[4 * index + 1] = 255;
-					map_mode_data[4 * index + 2] = 255;
-					map_mode_data[4 * index + 3] = 255;
-				}
-			});
-		} else if (item_selected_idx == 6) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto elevation = state.tile_get_elevation(tile);
-				auto score = (uint8_t)((elevation / 16000.f + 0.5f) * 255.f);
-				map_mode_data[4 * index + 0] = score;
-				map_mode_data[4 * index + 1] = score;
-				map_mode_data[4 * index + 2] = score;
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 7) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto soil_organics = state.tile_get_soil_organics(tile);
-				auto score = (uint8_t)(soil_organics * 255.f);
-				map_mode_data[4 * index + 0] = score;
-				map_mode_data[4 * index + 1] = score;
-				map_mode_data[4 * index + 2] = score;
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 8) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto ice = state.tile_get_ice(tile);
-				if (ice_age) {
-					ice = state.tile_get_ice_age_ice(tile);
-				}
-				auto score = (uint8_t)(ice * 6.f);
-				map_mode_data[4 * index + 0] = score;
-				map_mode_data[4 * index + 1] = score;
-				map_mode_data[4 * index + 2] = score;
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 9) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto rock = state.tile_get_bedrock(tile);
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto r = state.bedrock_get_r(rock);
-				auto g = state.bedrock_get_g(rock);
-				auto b = state.bedrock_get_b(rock);
-				map_mode_data[4 * index + 0] = (uint8_t)(r * 255);
-				map_mode_data[4 * index + 1] = (uint8_t)(g * 255);
-				map_mode_data[4 * index + 2] = (uint8_t)(b * 255);
-				map_mode_data[4 * index + 3] = 255;
-			});
-		} else if (item_selected_idx == 10) {
-			state.for_each_tile([&](dcon::tile_id tile) {
-				auto biome = state.tile_get_biome(tile);
-				auto fst = tile_to_fst(world_size, tile);
-				auto index = fst.x * world_size * world_size + fst.z * world_size + fst.y;
-				auto r = state.biome_get_r(biome);
-				auto g = state.biome_get_g(biome);
-				auto b = state.biome_get_b(biome);
-				map_mode_data[4 * index + 0] = (uint8_t)(r * 255);
-				map_mode_data[4 * index + 1] = (uint8_t)(g * 255);
-				map_mode_data[4 * index + 2] = (uint8_t)(b * 255);
-				map_mode_data[4 * index + 3] = 255;
-			});
+		map_mode_dirty.fill(glm::ivec4{0});
+		stream_map_fields(stream, nullptr);
+		// palettes follow the objects of the new world
+		map_mode_loaded = -1;
+	} else {
+		bool dirty = false;
+		for (auto& rect : map_mode_dirty) {
+			dirty = dirty || rect.x < rect.z;
+		}
+		if (dirty) {
+			auto rects = map_mode_dirty;
+			map_mode_dirty.fill(glm::ivec4{0});
+			stream_map_fields(stream, &rects);
 		}
-		commit_map_mode();
+	}
+
+	for (int slot = 0; slot < map_lua_fields; slot++) {
+		auto& values = lua_map_fields[slot];
+		if (values.empty()) continue;
+		stream_map_field(
+			stream, stream.scalar_texture, map_scalar_fields + slot, GL_RED, GL_FLOAT, nullptr,
+			[&](uint8_t* data, auto tiles) {
+				ve::apply([&](dcon::tile_id tile) {
+					std::memcpy(data + 4 * tile.index(), &values[tile.index()], sizeof(float));
+				}, tiles);
+			}
+		);
+		values.clear();
+	}
+
+	// fields are kept current by marked changes, so switching modes only replaces the palette
+	if (item_selected_idx == map_mode_loaded && !lua_map_mode_requested) {
+		return;
+	}
+
+	auto scalar_layer = [](map_field field) { return (int)field; };
+	auto index_layer = [](map_field field) { return (int)field - map_scalar_fields; };
+	glm::vec3 black {0.f};
+	glm::vec3 white {1.f};
+
+	map_mode_palette current {};
+	if (lua_map_mode_requested || lua_map_mode_active) {
+		lua_map_mode_requested = false;
+		lua_map_mode_active = true;
+		current = lua_map_mode;
+	} else switch (item_selected_idx) {
+	case 1:
+		current = ramp_map_mode(scalar_layer(map_field::coast), {{0.f, white}, {1.f, black}});
+		break;
+	case 2:
+		current = palette_map_mode(index_layer(map_field::plate), state.plate_size(), [](uint32_t i) {
+			dcon::plate_id plate {dcon::plate_id::value_base_t(i)};
+			return glm::vec3{state.plate_get_r(plate), state.plate_get_g(plate), state.plate_get_b(plate)};
+		});
+		break;
+	case 3:
+	case 4:
+		current = ramp_map_mode(
+			scalar_layer(item_selected_idx == 3 ? map_field::january_waterflow : map_field::july_waterflow),
+			{{0.f, {0.1f, 0.f, 0.f}}, {20000.f, {0.f, 0.f, 1.f}}}
+		);
+		break;
+	case 5:
+		current = ramp_map_mode(scalar_layer(map_field::land), {{0.f, black}, {1.f, white}});
+		break;
+	case 6:
+		current = ramp_map_mode(scalar_layer(map_field::elevation), {{-8000.f, black}, {8000.f, white}});
+		break;
+	case 7:
+		current = ramp_map_mode(scalar_layer(map_field::soil_organics), {{0.f, black}, {1.f, white}});
+		break;
+	case 8:
+		current = ramp_map_mode(scalar_layer(ice_age ? map_field::ice_age_ice : map_field::ice), {{0.f, black}, {42.5f, white}});
+		break;
+	case 9:
+		current = palette_map_mode(index_layer(map_field::bedrock), state.bedrock_size(), [](uint32_t i) {
+			dcon::bedrock_id rock {dcon::bedrock_id::value_base_t(i)};
+			return glm::vec3{state.bedrock_get_r(rock), state.bedrock_get_g(rock), state.bedrock_get_b(rock)};
+		});
+		break;
+	case 10:
+		current = palette_map_mode(index_layer(map_field::biome), state.biome_size(), [](uint32_t i) {
+			dcon::biome_id biome {dcon::biome_id::value_base_t(i)};
+			return glm::vec3{state.biome_get_r(biome), state.biome_get_g(biome), state.biome_get_b(biome)};
+		});
+		break;
+	case 11:
+		current = ramp_map_mode(scalar_layer(map_field::vegetation), {{0.f, {0.5f, 0.4f, 0.3f}}, {1.f, {0.1f, 0.5f, 0.1f}}});
+		break;
+	default:
+		current = ramp_map_mode(0, {{0.f, white}});
+		break;
+	}
+	map_mode_loaded = item_selected_idx;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, stream.palette_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(map_mode_palette), &current);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// placement of a chunk, shared by every program which draws the planet patch
+struct chunk_uniforms {
+	GLuint origin;
+	GLuint ds;
+	GLuint dt;
+	GLuint texcoord;
+	GLuint face;
+	GLuint world_size;
+	GLuint skirt_depth;
+};
+
+chunk_uniforms get_chunk_uniforms(GLuint program) {
+	return {
+		.origin = (GLuint)glGetUniformLocation(program, "chunk_origin"),
+		.ds = (GLuint)glGetUniformLocation(program, "chunk_ds"),
+		.dt = (GLuint)glGetUniformLocation(program, "chunk_dt"),
+		.texcoord = (GLuint)glGetUniformLocation(program, "chunk_texcoord"),
+		.face = (GLuint)glGetUniformLocation(program, "chunk_face"),
+		.world_size = (GLuint)glGetUniformLocation(program, "world_size"),
+		.skirt_depth = (GLuint)glGetUniformLocation(program, "skirt_depth"),
+	};
+}
+
+// edges of neighbours of any detail sample tiles of the chunk or tiles next to them,
+// so a skirt as deep as the relief range of the chunk with its border covers every crack along its edges
+float chunk_skirt_depth(std::vector<std::vector<glm::vec2>> const& relief, game::terrain_chunk const& chunk) {
+	auto level = (int)std::lround(-std::log2(chunk.size));
+	// ranges are built with the relief upload, until then any depth within the relief may be needed
+	if (level < 0 || level >= (int)relief.size()) {
+		return 2.f * max_relief;
+	}
+	auto cells = 1 << level;
+	auto s = std::clamp((int)(chunk.s * cells), 0, cells - 1);
+	auto t = std::clamp((int)(chunk.t * cells), 0, cells - 1);
+	auto range = relief[level][(chunk.face * cells + t) * cells + s];
+	return range.y - range.x;
+}
+
+void draw_chunks(
+	chunk_uniforms const& uniforms,
+	game::patch_mesh const& patch,
+	std::vector<game::terrain_chunk> const& chunks,
+	int world_size
+) {
+	glUniform1i(uniforms.world_size, world_size);
+	glBindVertexArray(patch.vao);
+	for (auto& chunk : chunks) {
+		glUniform1f(uniforms.skirt_depth, chunk_skirt_depth(world.map.relief, chunk));
+		auto origin = chunk_point(chunk, 0.f, 0.f);
+		auto ds = face_to_ds[chunk.face] * chunk.size;
+		auto dt = face_to_dt[chunk.face] * chunk.size;
+		glUniform3fv(uniforms.origin, 1, reinterpret_cast<const float *>(&origin));
+		glUniform3fv(uniforms.ds, 1, reinterpret_cast<const float *>(&ds));
+		glUniform3fv(uniforms.dt, 1, reinterpret_cast<const float *>(&dt));
+		glUniform4f(uniforms.texcoord, chunk.s, chunk.t, chunk.size, chunk.size);
+		glUniform1i(uniforms.face, chunk.face);
+		glDrawElements(
+			GL_TRIANGLES,
+			patch.index_count,
+			GL_UNSIGNED_INT,
+			nullptr
+		);
 	}
 }
 
@@ -1496,6 +1615,8 @@ struct shadow_shader {
 	GLuint program;
 	GLuint model;
 	GLuint view;
+	GLuint elevation_map;
+	chunk_uniforms chunk;
 };
 
 struct planet_data_shader {
@@ -1508,26 +1629,91 @@ struct planet_data_shader {
 	GLuint ambient_color;
 	GLuint albedo_color;
 	GLuint camera_position;
-	GLuint map_data;
+	GLuint map_scalar;
+	GLuint map_index;
+	GLuint elevation_map;
 	GLuint shadow_map;
 	GLuint shadow_layers;
 	GLuint is_sky;
 	GLuint shadow_projection;
+	chunk_uniforms chunk;
+};
+
+constexpr int MAX_SHADOW_CASCADES = 8;
+// cascades are reused while the sun turns less than this (radians)
+constexpr float shadow_sun_threshold = 0.005f;
+// fitted cascades are grown by this fraction, so small camera moves stay inside
+constexpr float shadow_cascade_margin = 0.1f;
+
+// one layer of the shadow map, kept until the sun moves or the camera leaves it
+struct shadow_cascade {
+	GLuint fbo;
+	glm::mat4 projection;
+	glm::vec3 light_direction;
+	bool valid;
 };
 
 struct world_rendering_data {
-	int shadow_layers;
-	std::vector<GLuint> shadow_fbo {};
-	std::vector<GLuint> shadow_renderbuffers {};
+	std::vector<shadow_cascade> shadow_cascades {};
 	int shadow_map_resolution;
 	shadow_shader shadow_shader;
 	planet_data_shader data_shader;
 	GLuint shadow_map_texture;
-	GLuint map_mode_texture;
+	map_mode_stream map_mode;
+	GLuint elevation_texture;
+	int world_size;
 
 	glm::vec3 albedo_world;
 };
 
+// (re)creates the depth only layers of the shadow map, every cascade is drawn again on the next frame
+void create_shadow_cascades(world_rendering_data& data, int count) {
+	for (auto& cascade : data.shadow_cascades) {
+		glDeleteFramebuffers(1, &cascade.fbo);
+	}
+	if (data.shadow_map_texture) {
+		glDeleteTextures(1, &data.shadow_map_texture);
+	}
+	data.shadow_cascades.clear();
+	data.shadow_cascades.resize(count);
+
+	glGenTextures(1, &data.shadow_map_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, data.shadow_map_texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// comparison in the sampler gives filtered visibility instead of depth
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexImage3D(
+		GL_TEXTURE_2D_ARRAY,
+		0,
+		GL_DEPTH_COMPONENT24,
+		data.shadow_map_resolution, data.shadow_map_resolution, count,
+		0,
+		GL_DEPTH_COMPONENT, GL_FLOAT, nullptr
+	);
+
+	for (auto i = 0; i < count; i++) {
+		auto& cascade = data.shadow_cascades[i];
+		cascade.valid = false;
+		glGenFramebuffers(1, &cascade.fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascade.fbo);
+		glFramebufferTextureLayer(
+			GL_DRAW_FRAMEBUFFER,
+			GL_DEPTH_ATTACHMENT,
+			data.shadow_map_texture, 0, i
+		);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			throw std::runtime_error("Incomplete framebuffer!");
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
 struct camera_data {
 	glm::mat4 view;
 	glm::vec3 position;
@@ -1596,10 +1782,6 @@ void update_camera(
 		near_plane = 0.01f;
 		far_plane = camera.position.z * 1.5f;
 	}
-	if (desired_zoom_level == 0) {
-		near_plane = 0.1f;
-		float far_plane = 0.6f;
-	}
 
 	camera.view = glm::lookAt(
 		camera.eye,
@@ -1607,6 +1789,9 @@ void update_camera(
 		{0.f, 1.f, 0.f}
 	);
 
+	// shadow cascades split the same range
+	camera.near_plane = near_plane;
+	camera.far_plane = far_plane;
 	camera.projection = glm::perspective(
 		glm::pi<float>() / 3.f, width / height, near_plane, far_plane
 	);
@@ -1616,7 +1801,6 @@ void render_world(
 	GLFWwindow* window,
 	world_rendering_data& rendering_data,
 	camera_data& camera,
-	std::vector<uint8_t>& map_mode_data,
 	const glm::vec3& light_direction,
 	const glm::vec3& ambient_color,
 	const glm::vec3& light_color,
@@ -1627,12 +1811,17 @@ void render_world(
 	glm::vec3 light_x = glm::normalize(glm::cross(light_z, {0.f, 0.f, 1.f}));
 	glm::vec3 light_y = glm::cross(light_x, light_z);
 
-	// drawing shadow maps
-	std::vector<glm::mat4> shadow_projections;
+	auto world_size = rendering_data.world_size;
+	auto max_level = chunk_levels(world_size);
+	frustum view_frustum (camera.projection * camera.view);
+	select_chunks(world.map.visible_chunks, camera.eye, max_level, &view_frustum);
+	// chunks out of view still cast shadows into it
+	select_chunks(world.map.shadow_chunks, camera.eye, max_level, nullptr);
 
-	assert(rendering_data.shadow_layers == rendering_data.shadow_fbo.size());
-	assert(rendering_data.shadow_layers == rendering_data.shadow_renderbuffers.size());
-	auto shadow_layers = rendering_data.shadow_layers;
+	// drawing shadow maps
+	auto& cascades = rendering_data.shadow_cascades;
+	auto shadow_layers = (int)cascades.size();
+	assert(shadow_layers <= MAX_SHADOW_CASCADES);
 
 	for (GLsizei i = 0; i < shadow_layers; i++) {
 		float ratio = camera.far_plane / camera.near_plane;
@@ -1648,117 +1837,84 @@ void render_world(
 
 		auto visible_world = frustum(projection_shadow_range * camera.view).vertices;
 
-		/*
-		std::vector<glm::vec3> visible_world {
-			{-2.f, -2.f, -2.f},
-			{-2.f, -2.f, +2.f},
-			{-2.f, +2.f, -2.f},
-			{+2.f, -2.f, -2.f},
-			{-2.f, +2.f, +2.f},
-			{+2.f, -2.f, +2.f},
-			{+2.f, +2.f, -2.f},
-			{+2.f, +2.f, +2.f},
-			{-2.f, -2.f, -2.f},
-		};
-		*/
-
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rendering_data.shadow_fbo[i]);
-
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LEQUAL);
-
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-
-		glDisable(GL_CULL_FACE);
-
-		glDisable(GL_BLEND);
-
-		glClearColor(1.0f, 1.0f, 0.0f, 0.0f);
-		glClearDepth(1.0f);
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, rendering_data.shadow_map_resolution, rendering_data.shadow_map_resolution);
-
-		// projection of corners on X
-		float min_x = std::numeric_limits<float>::max();
-		float max_x = -std::numeric_limits<float>::max();
-		for (auto& corner : visible_world) {
-			max_x = std::max(max_x, glm::dot(corner, light_x));
-			min_x = std::min(min_x, glm::dot(corner, light_x));
-		}
-
-		// projection of corners on Y
-		float min_y = std::numeric_limits<float>::max();
-		float max_y = -std::numeric_limits<float>::max();
-		for (auto& corner : visible_world) {
-			max_y = std::max(max_y, glm::dot(corner, light_y));
-			min_y = std::min(min_y, glm::dot(corner, light_y));
-		}
-
-		// projection of corners on Z
-		float min_z = std::numeric_limits<float>::max();
-		float max_z = -std::numeric_limits<float>::max();
-		for (auto& corner : visible_world) {
-			max_z = std::max(max_z, glm::dot(corner, light_z));
-			min_z = std::min(min_z, glm::dot(corner, light_z));
+		// cached cascade is kept while the sun is still and the slice of the view is inside of it
+		auto& cascade = cascades[i];
+		if (cascade.valid && glm::dot(cascade.light_direction, light_z) > cosf(shadow_sun_threshold)) {
+			bool covered = true;
+			for (auto& corner : visible_world) {
+				auto image = cascade.projection * glm::vec4{corner, 1.f};
+				covered = covered
+					&& std::abs(image.x) < 1.f
+					&& std::abs(image.y) < 1.f
+					&& std::abs(image.z) < 1.f;
+			}
+			if (covered) {
+				continue;
+			}
 		}
 
-		glm::vec3 true_center {0.f};
+		// projection of corners on light basis
+		glm::vec3 min {std::numeric_limits<float>::max()};
+		glm::vec3 max {-std::numeric_limits<float>::max()};
 		for (auto& corner : visible_world) {
-			true_center += corner;
+			glm::vec3 image {glm::dot(corner, light_x), glm::dot(corner, light_y), glm::dot(corner, light_z)};
+			min = glm::min(min, image);
+			max = glm::max(max, image);
 		}
-		true_center /= (float)(visible_world.size());
-
-/*
-		auto corner = ground.model.meshes[0].max + glm::vec3(0.0, 10.0, 0.0);
-		max_z = std::max(max_z, glm::dot(corner, light_z));
-		min_z = std::min(min_z, glm::dot(corner, light_z));
-
-		corner = ground.model.meshes[0].min;
-		max_z = std::max(max_z, glm::dot(corner, light_z));
-		min_z = std::min(min_z, glm::dot(corner, light_z));
-*/
 
-		glm::vec3 max = {max_x, max_y, max_z};
-		glm::vec3 min = {min_x, min_y, min_z};
-
-		auto center = (max + min) * 0.5f;
-
-		glm::vec3 to_min {};//min - center;
-		glm::vec3 to_max {};//max - center;
-
-
-
-		auto center_world = glm::mat3(light_x, light_y, light_z) * center;
+		auto margin = (max - min) * shadow_cascade_margin;
+		min -= margin;
+		max += margin;
+		// casters between the slice and the sun: everything up to the highest mountain
+		max.z = std::max(max.z, 1.f + max_relief);
 
 		auto ortho = glm::ortho(
-			min_x, max_x,
-			min_y, max_y,
-			-max_z, -min_z
+			min.x, max.x,
+			min.y, max.y,
+			-max.z, -min.z
 		);
 		auto basis_change = glm::mat4(glm::transpose(glm::mat3(light_x, light_y, light_z)));
 
 		glm::mat4 light_projection = ortho * basis_change;
-		auto new_basis_center = basis_change * glm::vec4{true_center, 1.f};
-		auto image_of_center = light_projection * glm::vec4{true_center, 1.f};
-		auto projection_of_center = glm::dot(light_z, true_center);
+		cascade.projection = light_projection;
+		cascade.light_direction = light_z;
+		cascade.valid = true;
+
+		cull_chunks(world.map.shadow_chunks, frustum(light_projection), world.map.cascade_chunks);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascade.fbo);
+
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LEQUAL);
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_BLEND);
 
-		shadow_projections.push_back(light_projection);
+		// slopes facing away from the sun would shadow themselves without it
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.f, 4.f);
 
-		// projection_full_range = light_projection;
+		glClearDepth(1.0f);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glViewport(0, 0, rendering_data.shadow_map_resolution, rendering_data.shadow_map_resolution);
 
 		glUseProgram(rendering_data.shadow_shader.program);
 		glm::mat4 model (1.f);
 		glUniformMatrix4fv(rendering_data.shadow_shader.model, 1, GL_FALSE, reinterpret_cast<float *>(&model));
 		glUniformMatrix4fv(rendering_data.shadow_shader.view, 1, GL_FALSE, reinterpret_cast<float *>(&light_projection));
+		glUniform1i(rendering_data.shadow_shader.elevation_map, 1);
 
-		glBindVertexArray(world.map.mesh.vao);
-		glDrawArrays(
-			GL_TRIANGLES,
-			0,
-			world.map.mesh.data.size()
-		);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, rendering_data.elevation_texture);
+		glActiveTexture(GL_TEXTURE0);
+
+		draw_chunks(rendering_data.shadow_shader.chunk, world.map.mesh, world.map.cascade_chunks, world_size);
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+	}
+
+	std::vector<glm::mat4> shadow_projections;
+	for (auto& cascade : cascades) {
+		shadow_projections.push_back(cascade.projection);
 	}
 
 	assert_no_errors();
@@ -1789,12 +1945,18 @@ void render_world(
 	assert_no_errors();
 	glBindTexture(GL_TEXTURE_2D_ARRAY, rendering_data.shadow_map_texture);
 	assert_no_errors();
-	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
-	assert_no_errors();
 
 	glActiveTexture(GL_TEXTURE0);
 	assert_no_errors();
-	glBindTexture(GL_TEXTURE_2D_ARRAY, rendering_data.map_mode_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, rendering_data.map_mode.scalar_texture);
+	assert_no_errors();
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, rendering_data.elevation_texture);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, rendering_data.map_mode.index_texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, rendering_data.map_mode.palette_buffer);
 	assert_no_errors();
 
 	glm::mat4 model (1.f);
@@ -1810,7 +1972,9 @@ void render_world(
 	assert_no_errors();
 	glUniform3fv(planet_shader.albedo_color, 1, reinterpret_cast<const float *>(&rendering_data.albedo_world));
 	glUniform3fv(planet_shader.camera_position, 1, reinterpret_cast<const float *>(&camera.eye));
-	glUniform1i(planet_shader.map_data, 0);
+	glUniform1i(planet_shader.map_scalar, 0);
+	glUniform1i(planet_shader.map_index, 2);
+	glUniform1i(planet_shader.elevation_map, 1);
 	glUniform1i(planet_shader.shadow_map, 10);
 	assert_no_errors();
 	glUniform1i(planet_shader.shadow_layers, shadow_layers);
@@ -1819,22 +1983,21 @@ void render_world(
 	assert_no_errors();
 	glUniformMatrix4fv(planet_shader.shadow_projection, shadow_layers, GL_FALSE, reinterpret_cast<float *>(shadow_projections.data()));
 	assert_no_errors();
-	glBindVertexArray(world.map.mesh.vao);
-	glDrawArrays(
-		GL_TRIANGLES,
-		0,
-		world.map.mesh.data.size()
-	);
+	draw_chunks(planet_shader.chunk, world.map.mesh, world.map.visible_chunks, world_size);
 
 
 	glCullFace(GL_FRONT);
 	glUniform1i(planet_shader.is_sky, 1);
-	glBindVertexArray(world.sky.mesh.vao);
-	glDrawArrays(
-		GL_TRIANGLES,
-		0,
-		world.sky.mesh.data.size()
-	);
+	// sky is a smooth sphere, whole faces are enough
+	static const std::vector<game::terrain_chunk> sky_chunks {
+		{0, 0.f, 0.f, 1.f},
+		{1, 0.f, 0.f, 1.f},
+		{2, 0.f, 0.f, 1.f},
+		{3, 0.f, 0.f, 1.f},
+		{4, 0.f, 0.f, 1.f},
+		{5, 0.f, 0.f, 1.f},
+	};
+	draw_chunks(planet_shader.chunk, world.map.mesh, sky_chunks, world_size);
 
 	assert_no_errors();
 }
@@ -1927,12 +2090,116 @@ extern "C" {
 	DCON_LUADLL_API void toggle_settings_window() {
 		settings_opened = !settings_opened;
 	}
+
+	// fills a scalar field for lua map modes, one value for every tile
+	DCON_LUADLL_API void map_mode_set_field(uint32_t slot, float const* values) {
+		if (slot >= map_lua_fields) {
+			window::emit_error_message("Invalid map field", false);
+			return;
+		}
+		lua_map_fields[slot].assign(values, values + state.tile_size());
+	}
+
+	// shows a lua field through a colour ramp: count stops of values and rgb colours
+	DCON_LUADLL_API void map_mode_show_field(uint32_t slot, int32_t count, float const* values, float const* colours) {
+		if (slot >= map_lua_fields || count < 1 || count > MAP_MODE_RAMP_SIZE) {
+			window::emit_error_message("Invalid map mode", false);
+			return;
+		}
+		lua_map_mode = {};
+		for (int32_t i = 0; i < count; i++) {
+			lua_map_mode.colours[i] = {colours[3 * i], colours[3 * i + 1], colours[3 * i + 2], 1.f};
+			lua_map_mode.stops[i].x = values[i];
+		}
+		lua_map_mode.mode = {map_scalar_fields + (int)slot, (int)map_mode_kind::ramp, count, 0};
+		lua_map_mode_requested = true;
+	}
+}
+
+// relief range of every chunk the quadtree can select: level l splits a face into 2^l x 2^l cells,
+// cell (s, t) of a face is at (face * 2^l + t) * 2^l + s;
+// ranges of tiles include their neighbours, also those across edges of faces
+void build_relief_ranges(std::vector<std::vector<glm::vec2>>& relief, std::vector<float> const& elevation, int world_size) {
+	std::vector<glm::vec2> tile_range(elevation.size());
+	concurrency::parallel_for(uint32_t(0), (uint32_t)elevation.size(), [&](auto i) {
+		dcon::tile_id tile {dcon::tile_id::value_base_t(i)};
+		glm::vec2 range {elevation[i], elevation[i]};
+		for (int j = 0; j < 4; j++) {
+			auto neighbour = state.tile_get_neighbour(tile, j);
+			if (!neighbour) continue;
+			auto value = elevation[neighbour.index()];
+			range = {std::min(range.x, value), std::max(range.y, value)};
+		}
+		tile_range[i] = range;
+	});
+
+	auto levels = chunk_levels(world_size);
+	relief.assign(levels + 1, {});
+	auto cells = 1 << levels;
+	relief[levels].resize(6 * cells * cells);
+	concurrency::parallel_for(0, 6 * cells * cells, [&](auto i) {
+		auto face = i / (cells * cells);
+		auto s = i % cells;
+		auto t = i / cells % cells;
+		glm::vec2 range {std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+		// vertices on the far edges of a chunk sample the first tile past it
+		auto s_end = std::min((s + 1) * world_size / cells + 1, world_size);
+		auto t_end = std::min((t + 1) * world_size / cells + 1, world_size);
+		for (auto tile_t = t * world_size / cells; tile_t < t_end; tile_t++) {
+			for (auto tile_s = s * world_size / cells; tile_s < s_end; tile_s++) {
+				auto& value = tile_range[((size_t)face * world_size + tile_t) * world_size + tile_s];
+				range = {std::min(range.x, value.x), std::max(range.y, value.y)};
+			}
+		}
+		relief[levels][i] = range;
+	});
+
+	for (int level = levels - 1; level >= 0; level--) {
+		auto n = 1 << level;
+		auto& fine = relief[level + 1];
+		auto& coarse = relief[level];
+		coarse.resize(6 * n * n);
+		for (int face = 0; face < 6; face++) {
+			for (int t = 0; t < n; t++) {
+				for (int s = 0; s < n; s++) {
+					auto child = [&](int ds, int dt) {
+						return fine[(face * 2 * n + 2 * t + dt) * 2 * n + 2 * s + ds];
+					};
+					auto a = child(0, 0), b = child(1, 0), c = child(0, 1), d = child(1, 1);
+					coarse[(face * n + t) * n + s] = {
+						std::min(std::min(a.x, b.x), std::min(c.x, d.x)),
+						std::max(std::max(a.y, b.y), std::max(c.y, d.y))
+					};
+				}
+			}
+		}
+	}
+}
+
+// elevation of tiles as radii of the planet surface,
+// tile index is face * world_size^2 + t * world_size + s, which is already the texel order of the array
+void upload_elevation(GLuint elevation_texture, int world_size) {
+	std::vector<float> elevation(state.tile_size());
+	concurrency::parallel_for(uint32_t(0), state.tile_size(), [&](auto i) {
+		elevation[i] = opengl_elevation(state.tile_get_elevation(dcon::tile_id{dcon::tile_id::value_base_t(i)}));
+	});
+	build_relief_ranges(world.map.relief, elevation, world_size);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, elevation_texture);
+	glTexImage3D(
+		GL_TEXTURE_2D_ARRAY,
+		0,
+		GL_R32F,
+		world_size, world_size, 6,
+		0,
+		GL_RED, GL_FLOAT, elevation.data()
+	);
 }
 
 void load_world_from_images(
 	lua_State* L,
-	std::vector<uint8_t>& map_mode_data,
-	GLuint& map_mode_texture,
+	map_mode_stream& map_mode,
+	GLuint& elevation_texture,
 	int& world_size
 ) {
 	int result;
@@ -1970,422 +2237,7 @@ void load_world_from_images(
 
 	// load images
 
-	// -- After we create the empty world, we can fill it with data...
-	printf("Loading tectonics map...");
-
-	{
-		ankerl::unordered_dense::map<int32_t, dcon::plate_id> detected_plates{};
-
-		std::string filename = "./lua/default/tectonics.png";
-		uint8_t * img;
-		int width, height, channels;
-
-		img = stbi_load(
-			filename.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto sphere = tile_to_sphere(world_size, tile);
-			auto rect = sphere_to_rect(sphere);
-			auto index = rect_to_image_index(width, height, rect);
-
-			auto r = img[index * 4 + 0];
-			auto g = img[index * 4 + 1];
-			auto b = img[index * 4 + 2];
-
-			auto cid = rgb_to_id(r, g, b);
-
-			auto it = detected_plates.find(cid);
-
-			if (it == detected_plates.end()) {
-				auto new_plate = state.create_plate();
-				state.plate_set_r(new_plate, (float)r / 255.f);
-				state.plate_set_g(new_plate, (float)g / 255.f);
-				state.plate_set_b(new_plate, (float)b / 255.f);
-				state.plate_set_direction(new_plate, 1);
-				detected_plates[cid] = new_plate;
-				state.force_create_plate_tiles(new_plate, tile);
-			} else {
-				state.force_create_plate_tiles(it->second, tile);
-			}
-		});
-	}
-
-	printf("Tectonic map loaded!\n");
-
-	printf("Generate tile neigbours\n");
-
-	float scaler_world = 1.f / float(world_size);
-	state.tile_resize_neighbour(4);
-
-	state.execute_parallel_over_tile([&](auto tiles) {
-		ve::apply([&](dcon::tile_id tile){
-			auto point = tile_to_sphere(world_size, tile);
-			auto box = sphere_to_box(point);
-			auto fst = tile_to_fst(world_size, tile);
-			auto shift_s = face_to_ds[fst.x] * scaler_world;
-			auto shift_t = face_to_dt[fst.x] * scaler_world;
-
-			state.tile_set_x(tile, point.x);
-			state.tile_set_y(tile, point.y);
-			state.tile_set_z(tile, point.z);
-
-			// 00 - forward
-			{
-				auto n = r3_to_tile(world_size, box + shift_s);
-				state.tile_set_neighbour(tile, 0, n);
-			}
-			// 01 - left
-			{
-				auto n = r3_to_tile(world_size, box - shift_t);
-				state.tile_set_neighbour(tile, 1, n);
-			}
-			// 10 - right
-			{
-				auto n = r3_to_tile(world_size, box + shift_t);
-				state.tile_set_neighbour(tile, 2, n);
-			}
-			// 11 - backward
-			{
-				auto n = r3_to_tile(world_size, box - shift_s);
-				state.tile_set_neighbour(tile, 3, n);
-
-				auto n_p = tile_to_sphere(world_size, state.tile_get_neighbour(tile, 3));
-				auto c_p = tile_to_sphere(world_size, tile);
-				auto distance = glm::distance(c_p, n_p);
-				assert(distance < scaler_world * 5.f);
-			}
-			assert(fst_to_tile(world_size, tile_to_fst(world_size, tile)) == tile);
-			assert(sphere_to_fst(world_size, point) == fst);
-			assert(glm::distance(point, fst_to_sphere(world_size, sphere_to_fst(world_size, point))) < scaler_world);
-		}, tiles);
-	});
-
-	printf("Tile neigbours are generated\n");
-
-	printf("Loading hydro maps\n");
-
-	{
-		std::string filename_january = "./lua/default/waterflow-january.png";
-		std::string filename_july = "./lua/default/waterflow-july.png";
-		uint8_t * january;
-		uint8_t * july;
-		int width, height, channels;
-
-		january = stbi_load(
-			filename_january.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-		july = stbi_load(
-			filename_july.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto sphere = tile_to_sphere(world_size, tile);
-			auto rect = sphere_to_rect(sphere);
-			auto index = rect_to_image_index(width, height, rect);
-
-			auto r_july = july[index * 4 + 0];
-			auto g_july = july[index * 4 + 1];
-			auto b_july = july[index * 4 + 2];
-
-			auto r_jan = january[index * 4 + 0];
-			auto g_jan = january[index * 4 + 1];
-			auto b_jan = january[index * 4 + 2];
-
-			auto flow_july = color_waterflow(r_july, g_july, b_july);
-			auto flow_january = color_waterflow(r_jan, g_jan, b_jan);
-
-			auto land =
-				color_is_land(r_july, g_july, b_july)
-				|| color_is_land(r_jan, g_jan, b_jan);
-
-			auto is_fresh =
-				color_is_fresh(r_july, g_july, b_july)
-				|| color_is_land(r_jan, g_jan, b_jan);
-
-			state.tile_set_is_land(tile, land);
-			state.tile_set_is_fresh(tile, is_fresh);
-			state.tile_set_july_waterflow(tile, flow_july);
-			state.tile_set_january_waterflow(tile, flow_january);
-			state.tile_set_waterlevel(tile, 0);
-
-			if ((flow_july + flow_january) > 2000.0) {
-				state.tile_set_has_river(tile, true);
-			}
-
-
-		});
-
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto is_land = state.tile_get_is_land(tile);
-			for (int i = 0; i < 4; i++) {
-				auto n = state.tile_get_neighbour(tile, i);
-				auto n_is_land = state.tile_get_is_land(n);
-				if (is_land != n_is_land) {
-					state.tile_set_is_coast(tile, true);
-					return;
-				}
-			}
-		});
-	}
-
-	printf("Hydro maps are loaded\n");
-
-	constexpr GLsizei cube_sides = 6;
-
-	{
-		printf("Loading heightmap...");
-
-		std::string filename = "./lua/default/heightmap.png";
-		uint8_t * img;
-		int width, height, channels;
-
-		img = stbi_load(
-			filename.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto sphere = tile_to_sphere(world_size, tile);
-			auto rect = sphere_to_rect(sphere);
-			auto index = rect_to_image_index(width, height, rect);
-
-			auto r = img[index * 4 + 0];
-			auto g = img[index * 4 + 1];
-			auto b = img[index * 4 + 2];
-
-			auto sea_level = 94.f;
-			auto elev = (float)r - sea_level;
-			if (elev < 0) {
-				elev = elev / sea_level * 8000.f;
-			} else {
-				elev = elev / (255.f - sea_level) * 8000.f;
-			}
-			state.tile_set_elevation(tile, elev);
-		});
-		printf("Heightmap loaded!\n");
-
-		printf("Correcting elevation...");
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto elevation = state.tile_get_elevation(tile);
-			if (state.tile_get_is_land(tile)) {
-				state.tile_set_elevation(tile, std::max(1.f, elevation));
-				state.tile_set_waterlevel(tile, 0);
-			} else {
-				state.tile_set_elevation(tile, std::min(-1.f, elevation));
-				state.tile_set_waterlevel(tile, 0);
-			}
-		});
-		printf("Elevation corrected!\n");
-	}
-
-	{
-		printf("Loading soils...");
-
-		std::string filename_depth = "./lua/default/soil-depth.png";
-		std::string filename_organics = "./lua/default/soil-organics.png";
-		std::string filename_minerals = "./lua/default/soil-minerals.png";
-		std::string filename_texture = "./lua/default/soil-texture.png";
-		uint8_t * depth;
-		uint8_t * organics;
-		uint8_t * minerals;
-		uint8_t * texture;
-		int width, height, channels;
-
-		depth = stbi_load(
-			filename_depth.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-		organics = stbi_load(
-			filename_organics.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-		minerals = stbi_load(
-			filename_minerals.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-		texture = stbi_load(
-			filename_texture.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-
-		state.for_each_tile([&] (dcon::tile_id tile) {
-
-			auto sphere = tile_to_sphere(world_size, tile);
-			auto rect = sphere_to_rect(sphere);
-			auto index = rect_to_image_index(width, height, rect);
-
-
-			auto depth_r = depth[index * 4 + 0];
-			auto depth_g = depth[index * 4 + 1];
-			auto depth_b = depth[index * 4 + 2];
-
-			auto organics_r = organics[index * 4 + 0];
-			auto organics_g = organics[index * 4 + 1];
-			auto organics_b = organics[index * 4 + 2];
-
-			auto minerals_r = minerals[index * 4 + 0];
-			auto minerals_g = minerals[index * 4 + 1];
-			auto minerals_b = minerals[index * 4 + 2];
-
-			auto texture_r = texture[index * 4 + 0];
-			auto texture_g = texture[index * 4 + 1];
-			auto texture_b = texture[index * 4 + 2];
-
-			float total = (float)texture_r + (float)texture_g + (float)texture_b;
-			if (total == 0) {
-				total = 0.001f;
-			}
-			auto sand = texture_r / total;
-			auto silt = texture_g / total;
-			auto clay = texture_b / total;
-
-			auto depth_hsv = rgb_to_hsv(
-				(float) depth_r / 255.f,
-				(float) depth_g / 255.f,
-				(float) depth_b / 255.f
-			);
-
-			auto actual_depth = depth_hsv.x;
-			auto depth = std::min(actual_depth, 235.f) / 235.f * 10.f;
-
-			state.tile_set_sand(tile, sand * actual_depth);
-			state.tile_set_silt(tile, silt * actual_depth);
-			state.tile_set_clay(tile, clay * actual_depth);
-
-			if (actual_depth == 0) {
-				state.tile_set_soil_minerals(tile, 0);
-				state.tile_set_soil_organics(tile, 0);
-			} else {
-				auto organics = rgb_to_hsv(organics_r, organics_g, organics_b).x;
-				state.tile_set_soil_organics(tile, std::min(organics, 235.f) / 235.f);
-				auto minerals = rgb_to_hsv(minerals_r, minerals_g, minerals_b).x;
-				state.tile_set_soil_minerals(tile, std::min(minerals, 235.f) / 235.f);
-			}
-		});
-		printf("Soils loaded!");
-	}
-
-
-	{
-		printf("Loading ice...");
-
-		std::string filename_ice = "./lua/default/ice.png";
-		std::string filename_ice_age_ice = "./lua/default/ice-age-ice.png";
-		uint8_t * ice;
-		uint8_t * ice_age_ice;
-		int width, height, channels;
-
-		ice = stbi_load(
-			filename_ice.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-		ice_age_ice = stbi_load(
-			filename_ice_age_ice.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-
-		auto get_ice = [](uint8_t r, uint8_t g, uint8_t b) {
-			if (g == 255 && b == 255) {
-				if (r == 210)  return 10.f;
-				else if (r == 225)  return 25.f;
-				else if (r == 240)  return 40.f;
-				else return 0.f;
-			} else return 0.f;
-		};
-
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto sphere = tile_to_sphere(world_size, tile);
-			auto rect = sphere_to_rect(sphere);
-			auto index = rect_to_image_index(width, height, rect);
-
-			state.tile_set_ice(tile,
-				get_ice(ice[index * 4], ice[index * 4 + 1], ice[index * 4 + 2])
-			);
-			state.tile_set_ice_age_ice(tile,
-				get_ice(ice_age_ice[index * 4], ice_age_ice[index * 4 + 1], ice_age_ice[index * 4 + 2])
-			);
-		});
-		printf("Ice loaded!");
-	}
-
-	{
-		printf("Loading rocks");
-
-		std::string rocks_filename = "./lua/default/rocks.png";
-		uint8_t * rocks;
-		int width, height, channels;
-
-		rocks = stbi_load(
-			rocks_filename.c_str(),
-			&width,
-			&height,
-			&channels,
-			4
-		);
-
-		// build a map for colors
-		ankerl::unordered_dense::map<int32_t, dcon::bedrock_id> color_to_bedrock{};
-
-		state.for_each_bedrock([&](auto bedrock){
-			auto cid = rgb_to_id(
-				state.bedrock_get_r(bedrock) * 255.f,
-				state.bedrock_get_g(bedrock) * 255.f,
-				state.bedrock_get_b(bedrock) * 255.f
-			);
-			color_to_bedrock[cid] = bedrock;
-		});
-
-		state.for_each_tile([&](dcon::tile_id tile) {
-			auto sphere = tile_to_sphere(world_size, tile);
-			auto rect = sphere_to_rect(sphere);
-			auto index = rect_to_image_index(width, height, rect);
-
-			auto cid = rgb_to_id(rocks[4 * index], rocks[4 * index + 1], rocks[4 * index + 2]);
-
-			auto it = color_to_bedrock.find(cid);
-
-			if (it == color_to_bedrock.end()) {
-				state.tile_set_bedrock(tile, dcon::bedrock_id{7});
-			} else {
-				state.tile_set_bedrock(tile, it->second);
-			}
-		});
-		printf("Rocks loaded!");
-	}
+	load_default_world(world_size);
 
 
 	lua_getfield(L, LUA_GLOBALSINDEX, "sote");
@@ -2402,67 +2254,19 @@ void load_world_from_images(
 	lua_pop(L, 1);
 	// [traceback
 
-	GLsizei map_mode_resolution = world_size;
-
+	create_map_mode_stream(map_mode, world_size);
 
-	map_mode_data.resize(4 * map_mode_layers * map_mode_resolution * map_mode_resolution);
-
-	glGenTextures(1, &map_mode_texture);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, map_mode_texture);
+	glGenTextures(1, &elevation_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, elevation_texture);
 	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	upload_elevation(elevation_texture, world_size);
 
-	generate_cube_sphere(state, world.map, world_size, false);
-	generate_cube_sphere(state, world.sky, world_size, true);
-
-	{
-		// really basic
-		// to be replaced with whatever squealing is doing in the shadows
-		printf("Spawn races");
-		state.pop_resize_dna(20);
-		state.for_each_race([&](dcon::race_id race){
-			state.for_each_tile([&](dcon::tile_id tile){
-				auto settlement = state.tile_get_settlement_from_settlement_tile(tile);
-				if (settlement) return;
-				if (!state.tile_get_is_land(tile)) return;
-
-
-				if (state.race_get_requires_large_river(race)) {
-					if (!state.tile_get_has_river(tile)) return;
-				}
-
-				if (state.race_get_requires_large_forest(race)) {
-					if(state.tile_get_conifer(tile) + state.tile_get_broadleaf(tile) < 0.5) return;
-				}
-
-				auto elevation = state.tile_get_elevation(tile);
-
-				auto january_temp = state.tile_get_january_temperature(tile);
-				auto july_temp = state.tile_get_july_temperature(tile);
-				auto min_temp = std::min(january_temp, july_temp);
-				auto avg_temp = (july_temp + january_temp) / 2.f;
-
-				if (state.race_get_minimum_comfortable_temperature(race) > avg_temp) return;
-				if (state.race_get_minimum_absolute_temperature(race) > min_temp) return;
-				if (state.race_get_minimum_comfortable_elevation(race) > elevation) return;
-
-				if (world.uniform(world.rng) > 0.0001f) return;
+	generate_patch(world.map.mesh);
 
-				auto s = state.create_settlement();
-				state.force_create_settlement_tile(s, tile);
-
-				auto leader = state.create_pop();
-				state.force_create_pop_location(s, leader);
-				state.pop_set_race(leader, race);
-				// set dna
-				for (int i = 0; i < 20; i ++) {
-					state.pop_set_dna(leader, i, world.uniform(world.rng));
-				}
-			});
-		});
-	}
+	spawn_races();
 
 	lua_pop(L, 1);
 	// [
@@ -3084,7 +2888,10 @@ int main(void) {
 	GLuint view_location = glGetUniformLocation(basic_shader, "view");
 	GLuint projection_location = glGetUniformLocation(basic_shader, "projection");
 	GLuint albedo_location = glGetUniformLocation(basic_shader, "albedo");
-	GLuint map_data_location = glGetUniformLocation(basic_shader, "map_data");
+	GLuint map_scalar_location = glGetUniformLocation(basic_shader, "map_scalar");
+	GLuint map_index_location = glGetUniformLocation(basic_shader, "map_index");
+	glUniformBlockBinding(basic_shader, glGetUniformBlockIndex(basic_shader, "map_mode"), 0);
+	GLuint elevation_map_location = glGetUniformLocation(basic_shader, "elevation_map");
 	GLuint color_location = glGetUniformLocation(basic_shader, "color");
 	GLuint use_texture_location = glGetUniformLocation(basic_shader, "use_texture");
 	GLuint light_direction_location = glGetUniformLocation(basic_shader, "light_direction");
@@ -3108,49 +2915,9 @@ int main(void) {
 	auto shadow_program = create_program(shadow_vertex_shader, shadow_fragment_shader);
 	GLuint shadow_model_location = glGetUniformLocation(shadow_program, "model");
 	GLuint shadow_transform_location = glGetUniformLocation(shadow_program, "transform");
+	GLuint shadow_elevation_map_location = glGetUniformLocation(shadow_program, "elevation_map");
 
-	GLsizei shadow_map_resolution = 2048 * 2;
-	const GLsizei shadow_layers = 1;
-
-	GLuint shadow_map;
-	glGenTextures(1, &shadow_map);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_map);
-	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexImage3D(
-		GL_TEXTURE_2D_ARRAY,
-		0,
-		GL_RG32F,
-		shadow_map_resolution, shadow_map_resolution, shadow_layers,
-		0,
-		GL_RGBA, GL_FLOAT, nullptr
-	);
-
-	std::vector<GLuint> shadow_fbo{};
-	std::vector<GLuint> shadow_renderbuffers{};
-
-	shadow_fbo.resize(shadow_layers);
-	shadow_renderbuffers.resize(shadow_layers);
-
-	for (GLsizei i = 0; i < shadow_layers; i ++) {
-		glGenFramebuffers(1, &shadow_fbo[i]);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_fbo[i]);
-		glFramebufferTextureLayer(
-		GL_DRAW_FRAMEBUFFER,
-		GL_COLOR_ATTACHMENT0,
-		shadow_map, 0, i
-		);
-
-		if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		throw std::runtime_error("Incomplete framebuffer!");
-
-		glGenRenderbuffers(1, &shadow_renderbuffers[i]);
-		glBindRenderbuffer(GL_RENDERBUFFER, shadow_renderbuffers[i]);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, shadow_map_resolution, shadow_map_resolution);
-		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, shadow_renderbuffers[i]);
-	}
+	GLsizei shadow_map_resolution = 2048;
 
 	glm::vec3 albedo_world {0.4f, 0.5f, 0.8f};
 	float albedo_character[] = {0.9f, 0.5f, 0.6f};
@@ -3206,6 +2973,7 @@ int main(void) {
 
 	settings current_settings {};
 	current_settings.ui_scale = 1.f;
+	current_settings.shadow_cascades = 4;
 
 	auto update_scene = [&]() {
 		for (auto& item : window_instances) {
@@ -3251,8 +3019,6 @@ int main(void) {
 	game::simple_mesh square {};
 	generate_square(square);
 
-	std::vector<uint8_t> map_mode_data;
-
 	// GLuint map_mode_texture;
 	int world_size = 1;
 
@@ -3264,14 +3030,13 @@ int main(void) {
 
 
 	world_rendering_data world_opengl_data {
-		.shadow_layers = shadow_layers,
-		.shadow_fbo = shadow_fbo,
-		.shadow_renderbuffers = shadow_renderbuffers,
 		.shadow_map_resolution = shadow_map_resolution,
 		.shadow_shader {
 			.program = shadow_program,
 			.model = shadow_model_location,
-			.view = shadow_transform_location
+			.view = shadow_transform_location,
+			.elevation_map = shadow_elevation_map_location,
+			.chunk = get_chunk_uniforms(shadow_program)
 		},
 		.data_shader {
 			.program = basic_shader,
@@ -3283,16 +3048,22 @@ int main(void) {
 			.ambient_color = ambient_location,
 			.albedo_color = albedo_location,
 			.camera_position = camera_position_location,
-			.map_data = map_data_location,
+			.map_scalar = map_scalar_location,
+			.map_index = map_index_location,
+			.elevation_map = elevation_map_location,
 			.shadow_map = shadow_map_location,
 			.shadow_layers = shadow_layers_location,
 			.is_sky = sky_flag_location,
 			.shadow_projection = render_shadow_transform_location,
+			.chunk = get_chunk_uniforms(basic_shader)
 		},
-		.shadow_map_texture = shadow_map,
-		.map_mode_texture = 0,
+		.shadow_map_texture = 0,
+		.map_mode {},
+		.elevation_texture = 0,
+		.world_size = 1,
 		.albedo_world = albedo_world
 	};
+	create_shadow_cascades(world_opengl_data, current_settings.shadow_cascades);
 
 	std::string path_to_bg = "./lua/data/gfx/backgrounds/background.png";
 	auto bg_key = new_text(state, game_text, path_to_bg.size(), path_to_bg.data());
@@ -3309,6 +3080,7 @@ int main(void) {
 					L,
 					map_mode_data,
 					map_mode_texture,
+					elevation_texture,
 					world_size
 				);
 				images_loaded = true;
@@ -3320,17 +3092,6 @@ int main(void) {
 	*/
 	// image_loading_thread.detach();
 
-	auto push_map_mode = [&]{
-		glTexImage3D(
-			GL_TEXTURE_2D_ARRAY,
-			0,
-			GL_RGBA,
-			world_size, world_size, map_mode_layers,
-			0,
-			GL_RGBA, GL_UNSIGNED_BYTE, map_mode_data.data()
-		);
-	};
-
 	mouse_probe probe;
 
 	glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -3393,11 +3154,25 @@ int main(void) {
 				);
 			}
 
+			if (ImGui::SliderInt(
+				"Shadow cascades", &current_settings.shadow_cascades, 1, MAX_SHADOW_CASCADES,
+				"%d", ImGuiSliderFlags_AlwaysClamp
+			)) {
+				create_shadow_cascades(world_opengl_data, current_settings.shadow_cascades);
+			}
+
 			ImGui::End();
 		}
 
 		if (current_scene == game_scene::world_exploration) {
-			map_modes(map_mode_data, world_size, push_map_mode);
+			if (take_elevation_changes()) {
+				upload_elevation(world_opengl_data.elevation_texture, world_opengl_data.world_size);
+				// new relief, old shadows
+				for (auto& cascade : world_opengl_data.shadow_cascades) {
+					cascade.valid = false;
+				}
+			}
+			map_modes(world_opengl_data.map_mode);
 		}
 
 		if (current_scene == game_scene::loading_images) {
@@ -3408,10 +3183,15 @@ int main(void) {
 				request_loading_images = false;
 				load_world_from_images(
 					L,
-					map_mode_data,
-					world_opengl_data.map_mode_texture,
+					world_opengl_data.map_mode,
+					world_opengl_data.elevation_texture,
 					world_size
 				);
+				world_opengl_data.world_size = world_size;
+				// new relief, old shadows
+				for (auto& cascade : world_opengl_data.shadow_cascades) {
+					cascade.valid = false;
+				}
 				images_loaded = true;
 				current_scene = game_scene::world_exploration;
 				update_scene();
@@ -3452,7 +3232,6 @@ int main(void) {
 				window,
 				world_opengl_data,
 				camera_opengl_data,
-				map_mode_data,
 				light_direction,
 				ambient_color,
 				light_color,
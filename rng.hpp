@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// counter based random numbers:
+// a value depends only on the seed and the key it is drawn for,
+// so results do not depend on thread count or iteration order
+namespace rng {
+
+inline uint64_t splitmix64(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+inline uint64_t get(uint64_t seed, uint64_t a, uint64_t b) {
+	return splitmix64(splitmix64(splitmix64(seed) ^ a) ^ b);
+}
+
+// [0, 1) with 24 bits of precision
+inline float to_unit(uint64_t value) {
+	return float(value >> 40) * (1.f / 16777216.f);
+}
+
+inline float uniform(uint64_t seed, uint64_t a, uint64_t b) {
+	return to_unit(get(seed, a, b));
+}
+
+// sequential engine for std distributions
+struct counter_engine {
+	using result_type = uint64_t;
+
+	uint64_t seed = 0;
+	uint64_t counter = 0;
+
+	static constexpr result_type min() {
+		return 0;
+	}
+	static constexpr result_type max() {
+		return std::numeric_limits<uint64_t>::max();
+	}
+	result_type operator()() {
+		return get(seed, counter++, 0);
+	}
+};
+
+}
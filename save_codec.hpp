@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// byte codecs for columns of a save:
+// small enums and bitfields are mostly runs of equal bytes,
+// smooth floats become runs after splitting them into byte planes and taking differences
+namespace codec {
+
+enum kind : uint8_t {
+	raw = 0,
+	rle = 1,
+	shuffle_delta_rle = 2,
+};
+
+constexpr size_t shuffle_width = 4;
+
+// control byte c < 128: c + 1 literal bytes follow
+// control byte c >= 128: the next byte is repeated c - 126 times
+inline void rle_encode(uint8_t const* input, size_t size, std::vector<uint8_t>& output) {
+	size_t i = 0;
+	while (i < size) {
+		size_t run = 1;
+		while (i + run < size && run < 129 && input[i + run] == input[i]) {
+			run++;
+		}
+		if (run >= 2) {
+			output.push_back(uint8_t(run + 126));
+			output.push_back(input[i]);
+			i += run;
+			continue;
+		}
+
+		size_t start = i;
+		size_t literal = 0;
+		while (i < size && literal < 128) {
+			if (i + 1 < size && input[i + 1] == input[i]) {
+				break;
+			}
+			i++;
+			literal++;
+		}
+		if (literal == 0) {
+			continue;
+		}
+		output.push_back(uint8_t(literal - 1));
+		output.insert(output.end(), input + start, input + start + literal);
+	}
+}
+
+inline bool rle_decode(uint8_t const* input, size_t size, uint8_t* output, size_t output_size) {
+	size_t i = 0;
+	size_t written = 0;
+	while (i < size) {
+		auto control = input[i++];
+		if (control < 128) {
+			size_t literal = size_t(control) + 1;
+			if (i + literal > size || written + literal > output_size) return false;
+			std::memcpy(output + written, input + i, literal);
+			i += literal;
+			written += literal;
+		} else {
+			size_t run = size_t(control) - 126;
+			if (i >= size || written + run > output_size) return false;
+			std::memset(output + written, input[i++], run);
+			written += run;
+		}
+	}
+	return written == output_size;
+}
+
+// planes of the n-th byte of every element, each plane stored as differences of neighbours
+inline void shuffle_delta(uint8_t const* input, size_t size, std::vector<uint8_t>& output) {
+	size_t count = size / shuffle_width;
+	output.resize(size);
+	size_t offset = 0;
+	for (size_t plane = 0; plane < shuffle_width; plane++) {
+		uint8_t previous = 0;
+		for (size_t i = 0; i < count; i++) {
+			auto value = input[i * shuffle_width + plane];
+			output[offset++] = uint8_t(value - previous);
+			previous = value;
+		}
+	}
+	std::memcpy(output.data() + offset, input + count * shuffle_width, size - count * shuffle_width);
+}
+
+inline void unshuffle_delta(uint8_t const* input, size_t size, uint8_t* output) {
+	size_t count = size / shuffle_width;
+	size_t offset = 0;
+	for (size_t plane = 0; plane < shuffle_width; plane++) {
+		uint8_t previous = 0;
+		for (size_t i = 0; i < count; i++) {
+			previous = uint8_t(previous + input[offset++]);
+			output[i * shuffle_width + plane] = previous;
+		}
+	}
+	std::memcpy(output + count * shuffle_width, input + offset, size - count * shuffle_width);
+}
+
+// picks whichever codec gives the smallest output
+inline kind encode(uint8_t const* input, size_t size, std::vector<uint8_t>& output) {
+	std::vector<uint8_t> runs;
+	runs.reserve(size / 4);
+	rle_encode(input, size, runs);
+
+	std::vector<uint8_t> planes;
+	shuffle_delta(input, size, planes);
+	std::vector<uint8_t> plane_runs;
+	plane_runs.reserve(size / 4);
+	rle_encode(planes.data(), planes.size(), plane_runs);
+
+	if (plane_runs.size() < runs.size() && plane_runs.size() < size) {
+		output = std::move(plane_runs);
+		return shuffle_delta_rle;
+	}
+	if (runs.size() < size) {
+		output = std::move(runs);
+		return rle;
+	}
+	output.assign(input, input + size);
+	return raw;
+}
+
+inline bool decode(kind codec, uint8_t const* input, size_t size, uint8_t* output, size_t output_size) {
+	switch (codec) {
+	case raw:
+		if (size != output_size) return false;
+		std::memcpy(output, input, size);
+		return true;
+	case rle:
+		return rle_decode(input, size, output, output_size);
+	case shuffle_delta_rle:
+	{
+		std::vector<uint8_t> planes(output_size);
+		if (!rle_decode(input, size, planes.data(), output_size)) return false;
+		unshuffle_delta(planes.data(), output_size, output);
+		return true;
+	}
+	}
+	return false;
+}
+
+}
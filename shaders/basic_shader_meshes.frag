@@ -3,13 +3,25 @@
 const float PI = 3.1415926535;
 
 // shadow things
-uniform sampler2DArray shadow_map;
-uniform mat4 shadow_transform [10];
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_transform [8];
 uniform int shadow_layers;
 uniform int sky_sphere;
 
-// data
-uniform sampler2DArray map_data;
+// raw fields of tiles, six layers (one per cube face) for every field
+uniform sampler2DArray map_scalar;
+uniform usampler2DArray map_index;
+uniform int world_size;
+
+// colouring of the current map mode, see map_mode_palette
+layout (std140) uniform map_mode {
+	// colours of ramp stops, or colours of objects by index + 1
+	vec4 map_colours[512];
+	// x is the field value of the ramp stop
+	vec4 map_stops[16];
+	// field layer, kind (0: ramp over a scalar field, 1: palette over an index field), number of ramp stops
+	ivec4 map_kind;
+};
 
 // color and lighting
 uniform vec3 albedo;
@@ -21,11 +33,13 @@ uniform vec3 camera_position;
 layout (location = 0) out vec4 out_color;
 
 // position things
-in vec3 frag_normal;
 in vec2 texcoord;
 in vec3 position;
 flat in uint face;
 
+// triangles are flat shaded, so the normal comes from derivatives of the position
+vec3 frag_normal;
+
 vec3 specular(vec3 albedo, vec3 direction) {
 	float cosine = dot(frag_normal, direction);
 	float light_factor = max(0.0, cosine);
@@ -64,6 +78,28 @@ vec3 specular_expanded(vec3 position, vec3 normal, vec3 albedo, vec3 direction)
 			);
 }
 
+vec3 map_mode_colour()
+{
+	ivec2 tile = min(ivec2(texcoord * world_size), ivec2(world_size - 1));
+	ivec3 texel = ivec3(tile, map_kind.x * 6 + int(face));
+
+	if (map_kind.y == 1) {
+		uint index = texelFetch(map_index, texel, 0).r;
+		return map_colours[min(int(index), 511)].rgb;
+	}
+
+	float value = texelFetch(map_scalar, texel, 0).r;
+	vec3 colour = map_colours[0].rgb;
+	for (int i = 1; i < map_kind.z; i++) {
+		float from = map_stops[i - 1].x;
+		float to = map_stops[i].x;
+		if (value > from) {
+			colour = mix(map_colours[i - 1].rgb, map_colours[i].rgb, clamp((value - from) / max(to - from, 1e-6), 0.0, 1.0));
+		}
+	}
+	return colour;
+}
+
 float TonemapRaw(float x)
 {
 	float A = 0.15;
@@ -83,10 +119,12 @@ float Uncharted2Tonemap(float luma)
 
 void main()
 {
-	vec3 data_location = vec3(texcoord.x, texcoord.y, face);
-	vec4 texture_value = texture(map_data, data_location);
+	frag_normal = normalize(cross(dFdx(position), dFdy(position)));
+	if (dot(frag_normal, position) < 0.0) {
+		frag_normal = -frag_normal;
+	}
 
-	vec3 albedo_color = texture_value.xyz;
+	vec3 albedo_color = map_mode_colour();
 	if (sky_sphere == 1) {
 		albedo_color = ambient;
 		// out_color = vec4(1.f, 0.f, 0.f, 1.f);
@@ -128,45 +166,21 @@ void main()
 	}
 
 	if (in_shadow_texture && sky_sphere == 0) {
-		vec2 sum = vec2(0.0, 0.0);
-		float sum_w = 0.0;
-		const int N = 4;
-		float radius = 1.0;
+		// every fetch compares depth in hardware and is bilinear filtered, the kernel softens the edge further
+		vec2 texel = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+		float reference = shadow_pos.z - 0.001;
+		float sum = 0.0;
+		const int N = 2;
 		for (int x = -N; x <= N; ++x)
 		{
 			for (int y = -N; y <= N; ++y)
 			{
-				float c = exp(-float(x*x + y*y) / (radius*radius));
-				vec3 texcoord = vec3(shadow_pos.xy + vec2(float(x), float(y)) / 1024.0 / 2.0, current_shadow_layer);
-				sum += c * texture(shadow_map, texcoord).rg;
-				sum_w += c;
+				vec2 offset = vec2(float(x), float(y)) * texel;
+				sum += texture(shadow_map, vec4(shadow_pos.xy + offset, current_shadow_layer, reference));
 			}
 		}
 
-		vec2 data = sum / sum_w;
-
-		// vec2 data = texture(shadow_map, shadow_pos.xy).rg;
-		float actual_length_of_light_ray = data.r;
-		float sigma = data.g - actual_length_of_light_ray * actual_length_of_light_ray;
-		float potential_length_of_light_ray = shadow_pos.z - 0.001;// ;
-
-		float length_of_shadow_ray = potential_length_of_light_ray - actual_length_of_light_ray;
-
-		float cheba = sigma / (sigma + length_of_shadow_ray * length_of_shadow_ray);
-		// float delta = 0.150;
-		float delta = 0.05;
-		cheba = (cheba - delta) / (1.f - delta);
-		if (cheba < 0.0) cheba = 0.0;
-
-		shadow_factor = (length_of_shadow_ray < 0) ? 1.0 : cheba;
-
-		// out_color = vec4(length_of_shadow_ray * 1000.f, 0, 0, 1);
-		// return;
-
-		// if (length_of_shadow_ray > 0) {
-		//     out_color = vec4(cheba, 0, 0, 1);
-		//     return;
-		// }
+		shadow_factor = sum / float((2 * N + 1) * (2 * N + 1));
 	}
 
 
@@ -4,21 +4,41 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-layout (location = 0) in vec3 in_position;
-layout (location = 1) in vec3 in_normal;
-layout (location = 2) in vec2 in_texcoord;
-layout (location = 3) in uint cube_face;
+// radius of the surface for every tile, layer is the cube face
+uniform sampler2DArray elevation_map;
+uniform int world_size;
+uniform int sky_sphere;
+
+// placement of the patch on its cube face: corner, both sides, and the same in face texture coordinates
+uniform vec3 chunk_origin;
+uniform vec3 chunk_ds;
+uniform vec3 chunk_dt;
+uniform vec4 chunk_texcoord;
+uniform int chunk_face;
+// how far skirts hang below the surface, in units of planet radius
+uniform float skirt_depth;
+
+layout (location = 0) in vec2 in_uv;
+// 1 for skirt vertices: they hang below the surface to hide cracks between neighbours of different detail
+layout (location = 1) in float in_skirt;
 
-out vec3 frag_normal;
 out vec2 texcoord;
 out vec3 position;
 flat out uint face;
 
 void main()
 {
+	vec3 direction = normalize(chunk_origin + in_uv.x * chunk_ds + in_uv.y * chunk_dt);
+	texcoord = chunk_texcoord.xy + in_uv * chunk_texcoord.zw;
+
+	float radius = 1.5;
+	if (sky_sphere == 0) {
+		ivec2 tile = min(ivec2(texcoord * world_size), ivec2(world_size - 1));
+		radius = texelFetch(elevation_map, ivec3(tile, chunk_face), 0).r - in_skirt * skirt_depth;
+	}
+	vec3 in_position = direction * radius;
+
 	gl_Position = projection * view * model * vec4(in_position, 1.0);
-	frag_normal = normalize(mat3(model) * in_normal);
-	texcoord = in_texcoord;
 	position = (model * vec4(in_position, 1.0)).xyz;
-	face = cube_face;
+	face = uint(chunk_face);
 }
\ No newline at end of file
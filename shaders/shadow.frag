@@ -1,12 +1,6 @@
 #version 330 core
 
-out vec4 out_color;
-
+// depth only pass, the depth buffer is the shadow map
 void main()
 {
-	float z = gl_FragCoord.z;
-	float z_x = dFdx(z);
-	float z_y = dFdy(z);
-	float slope = 0.25 * (z_x * z_x + z_y * z_y);
-	out_color = vec4(z, z * z + slope, 0.0, 0.0);
 }
\ No newline at end of file
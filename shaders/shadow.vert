@@ -3,9 +3,24 @@
 uniform mat4 model;
 uniform mat4 transform;
 
-layout (location = 0) in vec3 in_position;
+uniform sampler2DArray elevation_map;
+uniform int world_size;
+
+uniform vec3 chunk_origin;
+uniform vec3 chunk_ds;
+uniform vec3 chunk_dt;
+uniform vec4 chunk_texcoord;
+uniform int chunk_face;
+uniform float skirt_depth;
+
+layout (location = 0) in vec2 in_uv;
+layout (location = 1) in float in_skirt;
 
 void main()
 {
-	gl_Position = transform * model * vec4(in_position, 1.0);
+	vec3 direction = normalize(chunk_origin + in_uv.x * chunk_ds + in_uv.y * chunk_dt);
+	vec2 texcoord = chunk_texcoord.xy + in_uv * chunk_texcoord.zw;
+	ivec2 tile = min(ivec2(texcoord * world_size), ivec2(world_size - 1));
+	float radius = texelFetch(elevation_map, ivec3(tile, chunk_face), 0).r - in_skirt * skirt_depth;
+	gl_Position = transform * model * vec4(direction * radius, 1.0);
 }
\ No newline at end of file
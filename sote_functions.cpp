@@ -1,15 +1,28 @@
 // derived from Songs of FOSS
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
-#include <random>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include "data.hpp"
 #define DCON_LUADLL_EXPORTS
 #include "sote_functions.hpp"
 #include "sote_types.hpp"
+#include "rng.hpp"
+#include "save_codec.hpp"
 #include "lua-export.cpp"
 
 #ifdef _WIN32
@@ -20,12 +33,9 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 #endif
 
-// void save_to_file() {
-// 	state.make_s
-// }
-
 
 struct tile_cube_coord {
 	int32_t x;
@@ -33,6 +43,23 @@ struct tile_cube_coord {
 	int32_t f;
 };
 
+static uint64_t WORLD_SEED;
+
+void set_world_seed(uint64_t seed) {
+	WORLD_SEED = seed;
+}
+uint64_t get_world_seed(void) {
+	return WORLD_SEED;
+}
+
+// one uniform value per id, keyed by (world seed, id, stream)
+template<typename T>
+ve::fp_vector uniform_over(T ids, uint64_t stream) {
+	return ve::apply([&](auto id) {
+		return rng::uniform(WORLD_SEED, (uint64_t)id.index(), stream);
+	}, ids);
+}
+
 // backend time tracking
 static uint32_t WORLD_CURRENT_YEAR;
 static uint32_t WORLD_CURRENT_TICK;
@@ -42,13 +69,25 @@ static uint32_t WORLD_TICKS_PER_DAY;
 static uint32_t WORLD_TICKS_PER_MONTH;
 
 void set_world_current_year(uint32_t year) {
+	auto previous = WORLD_CURRENT_YEAR;
 	WORLD_CURRENT_YEAR = year;
+	// ages depend on the year as well, a refresh from the tick setter could have used the old one
+	if (WORLD_TICKS_PER_DAY == 0) return;
+	if (year != previous) {
+		update_pop_age_cache();
+	}
 }
 uint32_t get_world_current_year(void) {
 	return WORLD_CURRENT_YEAR;
 }
 void set_world_current_tick(uint32_t tick) {
+	auto previous = WORLD_CURRENT_TICK;
 	WORLD_CURRENT_TICK = tick;
+	// age cache is refreshed once per day
+	if (WORLD_TICKS_PER_DAY == 0) return;
+	if (tick < previous || tick / WORLD_TICKS_PER_DAY != previous / WORLD_TICKS_PER_DAY) {
+		update_pop_age_cache();
+	}
 }
 uint32_t get_world_current_tick(void) {
 	return WORLD_CURRENT_TICK;
@@ -113,6 +152,76 @@ constexpr inline float MINIMAL_WORKING_RATIO = 0.2f;
 
 constexpr inline float spending_ratio = 0.1f;
 
+// use_case -> contiguous span of (trade_good, weight)
+// use cases and trade goods are raws and do not change after load_raws,
+// so the table is rebuilt only on request instead of every tick
+// spans keep the order of use_case_for_each_use_weight_as_use_case
+struct use_case_table {
+	bool valid = false;
+	std::vector<uint32_t> offset;
+	std::vector<dcon::trade_good_id> trade_good;
+	std::vector<float> weight;
+	std::vector<float> good_consumption;
+};
+
+static use_case_table use_weights;
+
+// sparse inventory mode:
+// every pop keeps a bitmask of trade goods it may hold next to the dense inventory
+// masks are rebuilt during inventory decay and kept in sync by setters below,
+// so consumption can skip empty slots
+// the rebuild costs a pass over every good of every pop, so dense stays the default;
+// compare the dense and sparse rows of the benchmark before enabling it for a set of raws
+constexpr inline uint32_t INVENTORY_MASK_CAPACITY = 128;
+static bool SPARSE_INVENTORY = false;
+
+bool set_sparse_inventory(bool enabled) {
+	if (enabled && state.trade_good_size() > INVENTORY_MASK_CAPACITY) {
+		SPARSE_INVENTORY = false;
+		return false;
+	}
+	SPARSE_INVENTORY = enabled;
+	return true;
+}
+
+// raws and loaded states may bring more trade goods than masks hold after sparse mode was enabled
+void check_inventory_mask_capacity() {
+	if (SPARSE_INVENTORY && state.trade_good_size() > INVENTORY_MASK_CAPACITY) {
+		SPARSE_INVENTORY = false;
+		std::cout << "Sparse inventories are disabled: " << state.trade_good_size()
+			<< " trade goods do not fit into masks of " << INVENTORY_MASK_CAPACITY << "\n";
+	}
+}
+
+void pop_mark_inventory(dcon::pop_id pop, dcon::trade_good_id trade_good, bool nonzero) {
+	auto index = (uint32_t)trade_good.index();
+	if (index < 64) {
+		auto mask = state.pop_get_inventory_mask_low(pop);
+		auto bit = uint64_t(1) << index;
+		state.pop_set_inventory_mask_low(pop, nonzero ? (mask | bit) : (mask & ~bit));
+	} else {
+		auto mask = state.pop_get_inventory_mask_high(pop);
+		auto bit = uint64_t(1) << (index - 64);
+		state.pop_set_inventory_mask_high(pop, nonzero ? (mask | bit) : (mask & ~bit));
+	}
+}
+
+bool pop_may_hold(dcon::pop_id pop, dcon::trade_good_id trade_good) {
+	if (!SPARSE_INVENTORY) return true;
+	auto index = (uint32_t)trade_good.index();
+	if (index < 64) {
+		return (state.pop_get_inventory_mask_low(pop) >> index) & 1;
+	}
+	return (state.pop_get_inventory_mask_high(pop) >> (index - 64)) & 1;
+}
+
+void pop_set_inventory_tracked(dcon::pop_id pop, dcon::trade_good_id trade_good, float value) {
+	state.pop_set_inventory(pop, trade_good, value);
+	if (SPARSE_INVENTORY) {
+		pop_mark_inventory(pop, trade_good, value != 0.f);
+	}
+}
+
 float forage_efficiency(float foragers, float carrying_capacity) {
 	if (foragers > carrying_capacity) {
 		return carrying_capacity / (foragers + 1);
@@ -121,7 +230,11 @@ float forage_efficiency(float foragers, float carrying_capacity) {
 	}
 }
 
-void load_state(char const* name) {
+// maps the whole file into memory and hands it to the reader
+// a sparse reader touches only some parts of the file, so the rest is never read from disk
+template<typename F>
+bool read_mapped_file(char const* name, bool sparse, F&& reader) {
+	bool success = false;
 #ifdef _WIN32
 	int wchars_num = MultiByteToWideChar( CP_UTF8 , 0 , name , -1, NULL , 0 );
 	wchar_t* w_name = new wchar_t[wchars_num];
@@ -133,7 +246,8 @@ void load_state(char const* name) {
 		FILE_SHARE_READ,
 		nullptr,
 		OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		// sparse reads keep the default read ahead, which still helps inside the ranges they read
+		FILE_ATTRIBUTE_NORMAL | (sparse ? 0 : FILE_FLAG_SEQUENTIAL_SCAN),
 		nullptr
 	);
 
@@ -144,11 +258,9 @@ void load_state(char const* name) {
 			if(data) {
 				_LARGE_INTEGER pvalue;
 				GetFileSizeEx(file_handle, &pvalue);
-				auto file_size = uint32_t(pvalue.QuadPart);
+				auto file_size = uint64_t(pvalue.QuadPart);
 
-				dcon::load_record loaded;
-				dcon::load_record selection = state.make_serialize_record_everything();
-				state.deserialize(data, data + file_size, loaded, selection);
+				success = reader(data, file_size);
 
 				UnmapViewOfFile(data);
 			}
@@ -164,15 +276,15 @@ void load_state(char const* name) {
 		if(fstat(file_descriptor, &sb) != -1) {
 			auto file_size = sb.st_size;
 #if _POSIX_C_SOURCE >= 200112L
-			posix_fadvise(file_descriptor, 0, static_cast<off_t>(file_size), POSIX_FADV_WILLNEED);
+			if (!sparse) {
+				posix_fadvise(file_descriptor, 0, static_cast<off_t>(file_size), POSIX_FADV_WILLNEED);
+			}
 #endif
 #if defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(_SVID_SOURCE)
 			void* mapping_handle = mmap(0, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
 			assert(mapping_handle != MAP_FAILED);
 			std::byte const* content = static_cast<std::byte const*>(mapping_handle);
-			dcon::load_record loaded;
-			dcon::load_record selection = state.make_serialize_record_everything();
-			state.deserialize(content, content + file_size, loaded, selection);
+			success = reader(content, uint64_t(file_size));
 			if(munmap(mapping_handle, file_size) == -1) {
 				assert(false);
 			}
@@ -180,15 +292,705 @@ void load_state(char const* name) {
 			void* buffer = malloc(file_size);
 			read(file_descriptor, buffer, file_size);
 			std::byte const* content = static_cast<std::byte const*>(buffer);
-			dcon::load_record loaded;
-			dcon::load_record selection = state.make_serialize_record_everything();
-			state.deserialize(content, content + file_size, loaded, selection);
+			success = reader(content, uint64_t(file_size));
 			free(buffer);
 #endif
 		}
 		close(file_descriptor);
 	}
 #endif
+	return success;
+}
+
+// a reader announces a range of the file it is about to read front to back:
+// the range is read ahead in large requests, while the rest of a sparse read stays on disk
+void advise_read_range(std::byte const* content, uint64_t offset, uint64_t size) {
+#if !defined(_WIN32) && (defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE) || defined(_BSD_SOURCE) || defined(_SVID_SOURCE))
+	if (size == 0) return;
+	auto page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	auto start = (uintptr_t)(content + offset) & ~(page - 1);
+	auto end = (uintptr_t)(content + offset + size);
+	madvise((void*)start, end - start, MADV_SEQUENTIAL);
+	madvise((void*)start, end - start, MADV_WILLNEED);
+#endif
+}
+
+uint64_t hash_bytes(std::byte const* data, uint64_t size) {
+	uint64_t result = size;
+	uint64_t words = size / sizeof(uint64_t);
+	for (uint64_t i = 0; i < words; i++) {
+		uint64_t word;
+		std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+		result = (result ^ word) * 0x100000001b3ull;
+	}
+	for (uint64_t i = words * sizeof(uint64_t); i < size; i++) {
+		result = (result ^ uint64_t(data[i])) * 0x100000001b3ull;
+	}
+	return rng::splitmix64(result);
+}
+
+// writes into a temporary file first, so an interrupted save never replaces a good one;
+// every write gets its own temporary file, so two writers of one slot never publish each other's partial file
+bool write_file(char const* name, std::byte const* data, size_t size) {
+	static std::atomic<uint64_t> writes { 0 };
+	auto thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
+	std::string temporary = std::string(name)
+		+ "." + std::to_string(thread)
+		+ "." + std::to_string(writes.fetch_add(1))
+		+ ".tmp";
+	auto file = std::fopen(temporary.c_str(), "wb");
+	if (!file) return false;
+	auto written = std::fwrite(data, 1, size, file);
+	auto closed = std::fclose(file) == 0;
+	if (written != size || !closed) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, name, error);
+	return !error;
+}
+
+// compressed saves:
+// the state is serialized one load record field at a time, which gives one chunk per column,
+// and every chunk is stored with the codec that suits it best
+static bool SAVE_COMPRESSION = false;
+
+void set_save_compression(bool enabled) {
+	SAVE_COMPRESSION = enabled;
+}
+
+struct column_stream {
+	std::vector<std::byte> data;
+	// load record field of each chunk
+	std::vector<uint32_t> fields;
+	// chunk i is [offsets[i], offsets[i + 1])
+	std::vector<uint64_t> offsets;
+};
+
+static_assert(std::is_trivially_copyable_v<dcon::load_record>);
+constexpr size_t load_record_fields = sizeof(dcon::load_record) / sizeof(bool);
+
+dcon::load_record single_field_record(size_t field) {
+	dcon::load_record record;
+	std::memset(&record, 0, sizeof(record));
+	reinterpret_cast<bool*>(&record)[field] = true;
+	return record;
+}
+
+void serialize_columns(dcon::load_record const& selection, column_stream& stream) {
+	auto selected = reinterpret_cast<bool const*>(&selection);
+	auto& fields = stream.fields;
+	fields.clear();
+	stream.offsets.clear();
+	stream.offsets.push_back(0);
+	for (size_t i = 0; i < load_record_fields; i++) {
+		if (!selected[i]) continue;
+		auto size = state.serialize_size(single_field_record(i));
+		if (size == 0) continue;
+		fields.push_back((uint32_t)i);
+		stream.offsets.push_back(stream.offsets.back() + size);
+	}
+
+	stream.data.resize(stream.offsets.back());
+	for (size_t chunk = 0; chunk < fields.size(); chunk++) {
+		auto output = stream.data.data() + stream.offsets[chunk];
+		state.serialize(output, single_field_record(fields[chunk]));
+	}
+}
+
+struct compressed_state_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t chunk_count;
+	uint64_t raw_size;
+	// fields of the load record the save was written with: field ids of chunks are positions in it
+	uint64_t record_fields;
+};
+
+struct compressed_chunk_header {
+	uint64_t codec;
+	uint64_t raw_size;
+	uint64_t encoded_size;
+	// load record field serialized in the chunk, so loads of a part of the state can skip the rest
+	uint64_t field;
+};
+
+constexpr uint64_t compressed_state_magic = 0x314c4f4345544f53; // "SOTECOL1"
+constexpr uint32_t compressed_state_version = 2;
+
+bool write_compressed_state(char const* name, column_stream const& stream) {
+	auto chunk_count = (uint32_t)(stream.offsets.size() - 1);
+	std::vector<std::vector<uint8_t>> encoded(chunk_count);
+	std::vector<compressed_chunk_header> chunks(chunk_count);
+
+	concurrency::parallel_for(uint32_t(0), chunk_count, [&](auto chunk) {
+		auto input = reinterpret_cast<uint8_t const*>(stream.data.data() + stream.offsets[chunk]);
+		auto size = stream.offsets[chunk + 1] - stream.offsets[chunk];
+		chunks[chunk].codec = codec::encode(input, size, encoded[chunk]);
+		chunks[chunk].raw_size = size;
+		chunks[chunk].encoded_size = encoded[chunk].size();
+		chunks[chunk].field = stream.fields[chunk];
+	});
+
+	compressed_state_header header {
+		compressed_state_magic,
+		compressed_state_version,
+		chunk_count,
+		stream.data.size(),
+		load_record_fields
+	};
+
+	size_t total = sizeof(header) + chunk_count * sizeof(compressed_chunk_header);
+	for (auto& chunk : encoded) {
+		total += chunk.size();
+	}
+
+	std::vector<std::byte> buffer(total);
+	auto output = buffer.data();
+	std::memcpy(output, &header, sizeof(header));
+	output += sizeof(header);
+	std::memcpy(output, chunks.data(), chunk_count * sizeof(compressed_chunk_header));
+	output += chunk_count * sizeof(compressed_chunk_header);
+	for (auto& chunk : encoded) {
+		std::memcpy(output, chunk.data(), chunk.size());
+		output += chunk.size();
+	}
+
+	return write_file(name, buffer.data(), buffer.size());
+}
+
+bool is_compressed_state(std::byte const* content, uint64_t size) {
+	uint64_t magic = 0;
+	if (size < sizeof(compressed_state_header)) return false;
+	std::memcpy(&magic, content, sizeof(magic));
+	return magic == compressed_state_magic;
+}
+
+// with a selection only chunks of selected fields are decoded and written to the output
+bool decode_compressed_state(
+	std::byte const* content, uint64_t size, std::vector<std::byte>& output,
+	dcon::load_record const* selection = nullptr
+) {
+	compressed_state_header header;
+	std::memcpy(&header, content, sizeof(header));
+	if (header.version != compressed_state_version) return false;
+
+	auto table_size = uint64_t(header.chunk_count) * sizeof(compressed_chunk_header);
+	if (sizeof(header) + table_size > size) return false;
+	std::vector<compressed_chunk_header> chunks(header.chunk_count);
+	std::memcpy(chunks.data(), content + sizeof(header), table_size);
+
+	// after a change of the data layout field ids mean other fields:
+	// everything is decoded and deserialize picks sections by name
+	auto selected = header.record_fields == load_record_fields
+		? reinterpret_cast<bool const*>(selection)
+		: nullptr;
+	std::vector<uint8_t> keep(header.chunk_count);
+	std::vector<uint64_t> input_offsets(header.chunk_count + 1);
+	std::vector<uint64_t> output_offsets(header.chunk_count + 1);
+	input_offsets[0] = sizeof(header) + table_size;
+	output_offsets[0] = 0;
+	uint64_t raw_size = 0;
+	for (uint32_t i = 0; i < header.chunk_count; i++) {
+		keep[i] = !selected || (chunks[i].field < load_record_fields && selected[chunks[i].field]);
+		input_offsets[i + 1] = input_offsets[i] + chunks[i].encoded_size;
+		output_offsets[i + 1] = output_offsets[i] + (keep[i] ? chunks[i].raw_size : 0);
+		raw_size += chunks[i].raw_size;
+	}
+	if (input_offsets.back() > size || raw_size != header.raw_size) return false;
+
+	// neighbouring selected chunks are one range of the file
+	for (uint32_t i = 0; i < header.chunk_count;) {
+		if (!keep[i]) {
+			i++;
+			continue;
+		}
+		auto first = i;
+		while (i < header.chunk_count && keep[i]) {
+			i++;
+		}
+		advise_read_range(content, input_offsets[first], input_offsets[i] - input_offsets[first]);
+	}
+
+	output.resize(output_offsets.back());
+	std::vector<uint8_t> decoded(header.chunk_count);
+	concurrency::parallel_for(uint32_t(0), header.chunk_count, [&](auto i) {
+		if (!keep[i]) {
+			decoded[i] = 1;
+			return;
+		}
+		decoded[i] = codec::decode(
+			codec::kind(chunks[i].codec),
+			reinterpret_cast<uint8_t const*>(content + input_offsets[i]),
+			chunks[i].encoded_size,
+			reinterpret_cast<uint8_t*>(output.data() + output_offsets[i]),
+			chunks[i].raw_size
+		) ? 1 : 0;
+	});
+	for (auto success : decoded) {
+		if (!success) return false;
+	}
+	return true;
+}
+
+// sections outside of the selection are skipped by deserialize without being copied,
+// so their pages of the mapping are never touched
+dcon::load_record load_state_selective(char const* name, dcon::load_record const& selection, bool sparse) {
+	dcon::load_record loaded;
+	read_mapped_file(name, sparse, [&](std::byte const* content, uint64_t file_size) {
+		if (is_compressed_state(content, file_size)) {
+			std::vector<std::byte> decoded;
+			// chunks outside of the selection are neither decoded nor read from disk
+			if (!decode_compressed_state(content, file_size, decoded, &selection)) {
+				std::cout << "Corrupted save " << name << "\n";
+				return false;
+			}
+			state.deserialize(decoded.data(), decoded.data() + decoded.size(), loaded, selection);
+			return true;
+		}
+		state.deserialize(content, content + file_size, loaded, selection);
+		return true;
+	});
+	// raws could change with the save
+	use_weights.valid = false;
+	check_inventory_mask_capacity();
+	elevation_refresh();
+	return loaded;
+}
+
+void load_state(char const* name) {
+	load_state_selective(name, state.make_serialize_record_everything(), false);
+}
+
+void record_skip_climate_cells(dcon::load_record& record) {
+	record.climate_cell = false;
+	record.climate_cell_elevation = false;
+	record.climate_cell_water_fraction = false;
+	record.climate_cell_january_temperature = false;
+	record.climate_cell_january_rainfall = false;
+	record.climate_cell_january_humidity = false;
+	record.climate_cell_january_wind_speed = false;
+	record.climate_cell_july_temperature = false;
+	record.climate_cell_july_rainfall = false;
+	record.climate_cell_july_humidity = false;
+	record.climate_cell_july_wind_speed = false;
+	record.climate_cell_hadley_influence = false;
+	record.climate_cell_med_influence = false;
+	record.climate_cell_itcz_january = false;
+	record.climate_cell_itcz_july = false;
+	record.climate_cell_left_to_right_continentality = false;
+	record.climate_cell_right_to_left_continentality = false;
+	record.climate_cell_true_continentality = false;
+	record.climate_cell_distance_to_sea = false;
+	record.climate_cell_left_to_right_rain_shadow = false;
+	record.climate_cell_right_to_left_rain_shadow = false;
+	record.climate_cell_true_rain_shadow = false;
+	record.climate_cell_saldo_north = false;
+	record.climate_cell_saldo_south = false;
+	record.climate_cell_cache = false;
+	record.climate_cell_land_tiles = false;
+	record.climate_cell_water_tiles = false;
+}
+
+void load_state_without_climate(char const* name) {
+	auto selection = state.make_serialize_record_everything();
+	record_skip_climate_cells(selection);
+	load_state_selective(name, selection, true);
+}
+
+// delta saves:
+// a delta holds only the blocks of every column which differ from the last full save
+// the setters are generated and lua writes columns directly, so changes can't be tracked as they happen:
+// the state is serialized again and compared with the serialization of that save, which is kept in memory
+constexpr uint64_t delta_block_size = uint64_t(1) << 16;
+
+struct delta_base_layout {
+	bool valid = false;
+	// snapshots may finish out of order, only the latest full save becomes the base
+	uint64_t sequence = 0;
+	uint64_t id = 0;
+	column_stream stream;
+};
+
+static delta_base_layout delta_base;
+static std::mutex delta_base_mutex;
+static uint64_t full_save_sequence = 0;
+
+// the base takes the serialization of the save, callers don't use it after writing
+void remember_delta_base(column_stream&& stream, uint64_t sequence) {
+	delta_base_layout layout;
+	layout.valid = true;
+	layout.sequence = sequence;
+	layout.id = hash_bytes(stream.data.data(), stream.data.size());
+	layout.stream = std::move(stream);
+
+	std::lock_guard lock(delta_base_mutex);
+	if (sequence >= delta_base.sequence) {
+		delta_base = std::move(layout);
+	}
+}
+
+void save_state(char const* name) {
+	column_stream stream;
+	serialize_columns(state.make_serialize_record_everything(), stream);
+	auto success = SAVE_COMPRESSION
+		? write_compressed_state(name, stream)
+		: write_file(name, stream.data.data(), stream.data.size());
+	if (success) {
+		remember_delta_base(std::move(stream), ++full_save_sequence);
+	}
+}
+
+// snapshot saves:
+// the state is copied into a staging buffer between ticks and written to disk by a background thread
+// two buffers are kept, so a new snapshot waits only when both previous writes are still running
+struct save_slot {
+	column_stream stream;
+	std::string name;
+	bool compressed = false;
+	uint64_t sequence = 0;
+	std::thread writer;
+
+	void wait() {
+		if (writer.joinable()) writer.join();
+	}
+	~save_slot() {
+		wait();
+	}
+};
+
+static save_slot save_slots[2];
+static uint32_t next_save_slot = 0;
+
+void save_state_snapshot(char const* name) {
+	auto& slot = save_slots[next_save_slot];
+	next_save_slot = (next_save_slot + 1) % 2;
+	slot.wait();
+
+	serialize_columns(state.make_serialize_record_everything(), slot.stream);
+
+	slot.name = name;
+	slot.compressed = SAVE_COMPRESSION;
+	slot.sequence = ++full_save_sequence;
+	slot.writer = std::thread([&slot]() {
+		auto success = slot.compressed
+			? write_compressed_state(slot.name.c_str(), slot.stream)
+			: write_file(slot.name.c_str(), slot.stream.data.data(), slot.stream.data.size());
+		if (success) {
+			remember_delta_base(std::move(slot.stream), slot.sequence);
+		} else {
+			std::cout << "Failed to save " << slot.name << "\n";
+		}
+	});
+}
+
+void wait_for_saves() {
+	for (auto& slot : save_slots) {
+		slot.wait();
+	}
+}
+
+struct delta_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t field_count;
+	uint64_t base_id;
+	uint64_t base_size;
+	uint64_t block_size;
+};
+
+// base_size is absent_column when the column did not exist in the base
+struct delta_field_header {
+	uint32_t field;
+	uint32_t changed_blocks;
+	uint64_t base_offset;
+	uint64_t base_size;
+	uint64_t size;
+};
+
+constexpr uint64_t delta_magic = 0x31544c4445544f53; // "SOTEDLT1"
+constexpr uint32_t delta_version = 1;
+constexpr uint64_t absent_column = std::numeric_limits<uint64_t>::max();
+
+template<typename T>
+void append_bytes(std::vector<std::byte>& buffer, T const* data, size_t count) {
+	auto offset = buffer.size();
+	buffer.resize(offset + count * sizeof(T));
+	std::memcpy(buffer.data() + offset, data, count * sizeof(T));
+}
+
+bool save_state_delta(char const* name) {
+	wait_for_saves();
+
+	column_stream stream;
+	serialize_columns(state.make_serialize_record_everything(), stream);
+
+	std::lock_guard lock(delta_base_mutex);
+	if (!delta_base.valid) return false;
+	auto& base = delta_base.stream;
+
+	auto chunk_count = (uint32_t)stream.fields.size();
+	std::vector<delta_field_header> headers(chunk_count);
+	std::vector<std::vector<uint32_t>> changed(chunk_count);
+
+	concurrency::parallel_for(uint32_t(0), chunk_count, [&](auto chunk) {
+		auto& header = headers[chunk];
+		header.field = stream.fields[chunk];
+		header.base_offset = 0;
+		header.base_size = absent_column;
+		header.size = stream.offsets[chunk + 1] - stream.offsets[chunk];
+
+		for (size_t i = 0; i < base.fields.size(); i++) {
+			if (base.fields[i] == header.field) {
+				header.base_offset = base.offsets[i];
+				header.base_size = base.offsets[i + 1] - base.offsets[i];
+				break;
+			}
+		}
+
+		auto current = stream.data.data() + stream.offsets[chunk];
+		auto blocks = (header.size + delta_block_size - 1) / delta_block_size;
+		for (uint32_t block = 0; block < blocks; block++) {
+			auto start = block * delta_block_size;
+			auto block_size = std::min(delta_block_size, header.size - start);
+			// a block which grew or shrank with its column never matches
+			auto same =
+				header.base_size != absent_column
+				&& start + block_size <= header.base_size
+				&& block_size == std::min(delta_block_size, header.base_size - start)
+				&& std::memcmp(current + start, base.data.data() + header.base_offset + start, block_size) == 0;
+			if (!same) {
+				changed[chunk].push_back(block);
+			}
+		}
+		header.changed_blocks = (uint32_t)changed[chunk].size();
+	});
+
+	delta_header header {
+		delta_magic,
+		delta_version,
+		chunk_count,
+		delta_base.id,
+		base.data.size(),
+		delta_block_size
+	};
+
+	std::vector<std::byte> buffer;
+	append_bytes(buffer, &header, 1);
+	for (uint32_t chunk = 0; chunk < chunk_count; chunk++) {
+		append_bytes(buffer, &headers[chunk], 1);
+		append_bytes(buffer, changed[chunk].data(), changed[chunk].size());
+		for (auto block : changed[chunk]) {
+			auto start = block * delta_block_size;
+			auto block_size = std::min(delta_block_size, headers[chunk].size - start);
+			append_bytes(buffer, stream.data.data() + stream.offsets[chunk] + start, block_size);
+		}
+	}
+
+	return write_file(name, buffer.data(), buffer.size());
+}
+
+// rebuilds the serialization the delta was taken from
+bool apply_state_delta(std::vector<std::byte> const& base, std::byte const* delta, uint64_t size, column_stream& output) {
+	delta_header header;
+	if (size < sizeof(header)) return false;
+	std::memcpy(&header, delta, sizeof(header));
+	if (
+		header.magic != delta_magic
+		|| header.version != delta_version
+		|| header.block_size != delta_block_size
+		|| header.base_size != base.size()
+		|| header.base_id != hash_bytes(base.data(), base.size())
+	) {
+		return false;
+	}
+
+	output.data.clear();
+	output.fields.clear();
+	output.offsets.assign(1, 0);
+	uint64_t position = sizeof(header);
+	for (uint32_t chunk = 0; chunk < header.field_count; chunk++) {
+		delta_field_header field;
+		if (position + sizeof(field) > size) return false;
+		std::memcpy(&field, delta + position, sizeof(field));
+		position += sizeof(field);
+
+		auto start = output.data.size();
+		output.data.resize(start + field.size);
+		output.fields.push_back(field.field);
+		output.offsets.push_back(start + field.size);
+		if (field.base_size != absent_column) {
+			if (field.base_offset + field.base_size > base.size()) return false;
+			std::memcpy(output.data.data() + start, base.data() + field.base_offset, std::min(field.base_size, field.size));
+		}
+
+		std::vector<uint32_t> blocks(field.changed_blocks);
+		if (position + blocks.size() * sizeof(uint32_t) > size) return false;
+		std::memcpy(blocks.data(), delta + position, blocks.size() * sizeof(uint32_t));
+		position += blocks.size() * sizeof(uint32_t);
+
+		for (auto block : blocks) {
+			auto block_start = block * delta_block_size;
+			if (block_start >= field.size) return false;
+			auto block_size = std::min(delta_block_size, field.size - block_start);
+			if (position + block_size > size) return false;
+			std::memcpy(output.data.data() + start + block_start, delta + position, block_size);
+			position += block_size;
+		}
+	}
+	return position == size;
+}
+
+// raw serialization stored in a save, whichever encoding it uses
+bool read_state_stream(char const* name, std::vector<std::byte>& output) {
+	return read_mapped_file(name, false, [&](std::byte const* content, uint64_t file_size) {
+		if (is_compressed_state(content, file_size)) {
+			return decode_compressed_state(content, file_size, output);
+		}
+		output.assign(content, content + file_size);
+		return true;
+	});
+}
+
+bool read_state_with_delta(char const* base_name, char const* delta_name, column_stream& output) {
+	std::vector<std::byte> base;
+	if (!read_state_stream(base_name, base)) return false;
+	return read_mapped_file(delta_name, false, [&](std::byte const* content, uint64_t file_size) {
+		return apply_state_delta(base, content, file_size, output);
+	});
+}
+
+bool load_state_with_delta(char const* base_name, char const* delta_name) {
+	column_stream stream;
+	if (!read_state_with_delta(base_name, delta_name, stream)) {
+		std::cout << "Delta " << delta_name << " does not match " << base_name << "\n";
+		return false;
+	}
+	dcon::load_record loaded;
+	dcon::load_record selection = state.make_serialize_record_everything();
+	state.deserialize(stream.data.data(), stream.data.data() + stream.data.size(), loaded, selection);
+	use_weights.valid = false;
+	check_inventory_mask_capacity();
+	elevation_refresh();
+	return true;
+}
+
+// merges a delta into its base and writes the result as a new full save,
+// which later deltas are taken against
+bool compact_state(char const* base_name, char const* delta_name, char const* output_name) {
+	column_stream merged;
+	if (!read_state_with_delta(base_name, delta_name, merged)) return false;
+	auto success = SAVE_COMPRESSION
+		? write_compressed_state(output_name, merged)
+		: write_file(output_name, merged.data.data(), merged.data.size());
+	if (success) {
+		remember_delta_base(std::move(merged), ++full_save_sequence);
+	}
+	return success;
+}
+
+// baked world:
+// tile and plate data produced from the source images, so later launches can skip decoding them
+// the header ties the payload to the images it was baked from
+struct world_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fingerprint;
+	uint64_t payload_size;
+	uint64_t checksum;
+};
+
+constexpr uint32_t world_cache_magic = 0x454b4142; // "BAKE"
+constexpr uint32_t world_cache_version = 1;
+
+dcon::load_record world_cache_record() {
+	dcon::load_record record;
+
+	record.tile = true;
+	record.tile_neighbour = true;
+	record.tile_x = true;
+	record.tile_y = true;
+	record.tile_z = true;
+	record.tile_is_land = true;
+	record.tile_is_fresh = true;
+	record.tile_is_coast = true;
+	record.tile_has_river = true;
+	record.tile_january_waterflow = true;
+	record.tile_july_waterflow = true;
+	record.tile_waterlevel = true;
+	record.tile_elevation = true;
+	record.tile_sand = true;
+	record.tile_silt = true;
+	record.tile_clay = true;
+	record.tile_soil_minerals = true;
+	record.tile_soil_organics = true;
+	record.tile_ice = true;
+	record.tile_ice_age_ice = true;
+	record.tile_bedrock = true;
+
+	record.plate = true;
+	record.plate_r = true;
+	record.plate_g = true;
+	record.plate_b = true;
+	record.plate_speed = true;
+	record.plate_direction = true;
+	record.plate_expansion_rate = true;
+
+	record.plate_tiles = true;
+	record.plate_tiles_plate = true;
+	record.plate_tiles_tile = true;
+
+	return record;
+}
+
+
+bool load_world_cache(char const* name, uint64_t fingerprint) {
+	return read_mapped_file(name, false, [fingerprint](std::byte const* content, uint64_t file_size) {
+		world_cache_header header;
+		if (file_size < sizeof(header)) return false;
+		std::memcpy(&header, content, sizeof(header));
+
+		if (
+			header.magic != world_cache_magic
+			|| header.version != world_cache_version
+			|| header.fingerprint != fingerprint
+			|| header.payload_size != file_size - sizeof(header)
+		) {
+			return false;
+		}
+
+		auto payload = content + sizeof(header);
+		if (hash_bytes(payload, header.payload_size) != header.checksum) {
+			return false;
+		}
+
+		dcon::load_record loaded;
+		dcon::load_record selection = world_cache_record();
+		state.deserialize(payload, payload + header.payload_size, loaded, selection);
+		return true;
+	});
+}
+
+bool save_world_cache(char const* name, uint64_t fingerprint) {
+	auto record = world_cache_record();
+	auto payload_size = state.serialize_size(record);
+
+	std::vector<std::byte> buffer(sizeof(world_cache_header) + payload_size);
+	auto payload = buffer.data() + sizeof(world_cache_header);
+	auto output = payload;
+	state.serialize(output, record);
+
+	world_cache_header header {
+		world_cache_magic,
+		world_cache_version,
+		fingerprint,
+		payload_size,
+		hash_bytes(payload, payload_size)
+	};
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	return write_file(name, buffer.data(), buffer.size());
 }
 
 // converting birth tick into human readable values
@@ -240,7 +1042,7 @@ uint32_t age_years(dcon::pop_id pop) {
 	return age_ticks(pop) / WORLD_TICKS_PER_MONTH / 12;
 }
 // using age values
-float age_multiplier(dcon::pop_id pop) {
+float compute_age_multiplier(dcon::pop_id pop) {
 	float age_multiplier = 1.f;
 	auto age = age_ticks(pop);
 	auto race = state.pop_get_race(pop);
@@ -257,8 +1059,7 @@ float age_multiplier(dcon::pop_id pop) {
 	}
 	return age_multiplier;
 }
-// pop time calculations
-float pop_free_time(dcon::pop_id pop) {
+float compute_free_time(dcon::pop_id pop) {
 	auto age = age_ticks(pop);
 	auto race = state.pop_get_race(pop);
 	auto teen = state.race_get_teen_age(race) * WORLD_TICKS_PER_MONTH * 12;
@@ -268,6 +1069,46 @@ float pop_free_time(dcon::pop_id pop) {
 		return 1.f;
 	}
 }
+uint8_t compute_age_bracket(dcon::pop_id pop) {
+	auto age = age_years(pop);
+	auto race = state.pop_get_race(pop);
+	if (age < state.race_get_child_age(race)) {
+		return 0;
+	}
+	if (age < state.race_get_teen_age(race)) {
+		return 1;
+	}
+	if (age < state.race_get_adult_age(race)) {
+		return 2;
+	}
+	if (age < state.race_get_middle_age(race)) {
+		return 3;
+	}
+	if (age < state.race_get_elder_age(race)) {
+		return 4;
+	}
+	return 5;
+}
+// age is below teen age of the race
+bool is_young(dcon::pop_id pop) {
+	if (state.pop_get_cached_age_valid(pop)) {
+		return state.pop_get_cached_age_bracket(pop) < 2;
+	}
+	return age_years(pop) < state.race_get_teen_age(state.pop_get_race(pop));
+}
+float age_multiplier(dcon::pop_id pop) {
+	if (state.pop_get_cached_age_valid(pop)) {
+		return state.pop_get_cached_age_multiplier(pop);
+	}
+	return compute_age_multiplier(pop);
+}
+// pop time calculations
+float pop_free_time(dcon::pop_id pop) {
+	if (state.pop_get_cached_age_valid(pop)) {
+		return state.pop_get_cached_free_time(pop);
+	}
+	return compute_free_time(pop);
+}
 float pop_warband_time(dcon::pop_id pop, float free) {
 	auto remaining = free - 0.05f;
 	if (remaining <= 0.f) {
@@ -304,6 +1145,81 @@ float pop_work_time(dcon::pop_id pop, float free, float warband, float forage) {
 	}
 }
 
+// vector variants of pop time calculations
+// lanes of deleted pops and padding lanes past the last pop get zeros
+template<typename P>
+ve::fp_vector pops_free_time(P pops) {
+	auto cached = state.pop_get_cached_free_time(pops);
+	// pops created since the last cache refresh are rare, they are calculated directly
+	return ve::apply([&](dcon::pop_id pop, float value) {
+		if (!state.pop_is_valid(pop)) return 0.f;
+		return state.pop_get_cached_age_valid(pop) ? value : compute_free_time(pop);
+	}, pops, cached);
+}
+template<typename P>
+ve::fp_vector pops_warband_time(P pops, ve::fp_vector free) {
+	auto time = ve::apply([&](dcon::pop_id pop) {
+		if (!state.pop_is_valid(pop)) return 0.f;
+		auto warband = state.warband_unit_get_warband(state.pop_get_warband_unit_as_unit(pop));
+		return state.warband_is_valid(warband) ? state.warband_get_current_time_used_ratio(warband) : 0.f;
+	}, pops);
+	auto remaining = free - 0.05f;
+	return ve::select(remaining <= 0.f, 0.f, ve::select(remaining < time, remaining, time));
+}
+template<typename P>
+ve::fp_vector pops_forage_time(P pops, ve::fp_vector free, ve::fp_vector warband) {
+	auto remaining = free - warband;
+	auto desire = state.pop_get_forage_ratio(pops);
+	return ve::select(remaining < desire, remaining, desire);
+}
+inline ve::fp_vector pops_work_time(ve::fp_vector free, ve::fp_vector warband, ve::fp_vector forage) {
+	auto remaining = free - warband - forage;
+	return ve::select(remaining < 0.f, 0.f, remaining);
+}
+
+// batch variants of pop time calculations
+// results are written in the order of the given pops, invalid pops get zeros
+void pops_time_budget(dcon::pop_id const* pops, uint32_t count, float* free, float* warband, float* forage, float* work) {
+	for (uint32_t i = 0; i < count; i++) {
+		auto pop = pops[i];
+		if (!state.pop_is_valid(pop)) {
+			free[i] = 0.f;
+			warband[i] = 0.f;
+			forage[i] = 0.f;
+			work[i] = 0.f;
+			continue;
+		}
+		auto free_time = pop_free_time(pop);
+		auto warband_time = pop_warband_time(pop, free_time);
+		auto forage_time = pop_forage_time(pop, free_time, warband_time);
+		free[i] = free_time;
+		warband[i] = warband_time;
+		forage[i] = forage_time;
+		work[i] = pop_work_time(pop, free_time, warband_time, forage_time);
+	}
+}
+// results are indexed by pop index, which is the lua id minus one; buffers should hold pop_size() values;
+// slots of deleted pops get zeros
+void pops_time_budget_all(float* free, float* warband, float* forage, float* work) {
+	auto size = state.pop_size();
+	state.execute_parallel_over_pop([&](auto pops) {
+		auto free_time = pops_free_time(pops);
+		auto warband_time = pops_warband_time(pops, free_time);
+		auto forage_time = pops_forage_time(pops, free_time, warband_time);
+		auto work_time = pops_work_time(free_time, warband_time, forage_time);
+		ve::apply([&](dcon::pop_id pop, float free_value, float warband_value, float forage_value, float work_value) {
+			auto i = uint32_t(pop.index());
+			// padding lanes of the last vector have no slot in the buffers
+			if (i >= size) return;
+			bool valid = state.pop_is_valid(pop);
+			free[i] = valid ? free_value : 0.f;
+			warband[i] = valid ? warband_value : 0.f;
+			forage[i] = valid ? forage_value : 0.f;
+			work[i] = valid ? work_value : 0.f;
+		}, pops, free_time, warband_time, forage_time, work_time);
+	});
+}
+
 float job_efficiency(dcon::race_id race, bool female, uint8_t jobtype) {
 	if (female) {
 		return state.race_get_female_efficiency(race, jobtype) ;
@@ -320,7 +1236,7 @@ float job_efficiency(dcon::pop_id pop, uint8_t jobtype) {
 
 bool pop_same_location(dcon::pop_id a, dcon::pop_id b) {
 	auto a_location = state.pop_location_get_location(state.pop_get_pop_location_as_pop(a));
-	auto b_location = state.pop_location_get_location(state.pop_get_pop_location_as_pop(a));
+	auto b_location = state.pop_location_get_location(state.pop_get_pop_location_as_pop(b));
 	if (state.settlement_is_valid(a_location) && a_location == b_location) {
 		return true;
 	} // if not in same settlement, check if in same party
@@ -333,23 +1249,114 @@ bool pop_same_location(dcon::pop_id a, dcon::pop_id b) {
 }
 
 bool is_dependent_of(dcon::pop_id pop, dcon::pop_id parent) {
-	auto age = age_years(pop);
-	auto race = state.pop_get_race(pop);
-	auto teen_age = state.race_get_teen_age(race);
-	if (age < teen_age && parent && pop_same_location(pop,parent))
+	if (is_young(pop) && parent && pop_same_location(pop,parent))
 		return true;
 	return false;
 }
+// only youth comes from the daily cache: parents die and pops move between ticks,
+// so the parent and locations are read as they are now
 bool is_dependent(dcon::pop_id pop) {
-	auto age = age_years(pop);
-	auto race = state.pop_get_race(pop);
-	auto teen_age = state.race_get_teen_age(race);
 	auto parent = state.parent_child_relation_get_parent(state.pop_get_parent_child_relation_as_child(pop));
-	if (age < teen_age && parent && pop_same_location(pop,parent))
+	if (is_young(pop) && parent && pop_same_location(pop,parent))
 		return true;
 	return false;
 }
 
+void pop_reset_age_cache(dcon::pop_id pop) {
+	state.pop_set_cached_age_valid(pop, 0);
+}
+
+// refreshes derived age state of all pops
+// values stay fixed until the next day, pops created in between fall back to direct calculation
+// as long as their creation resets the cache, see pop_reset_age_cache
+void update_pop_age_cache() {
+	auto conversion = (float)(WORLD_TICKS_PER_MONTH * 12);
+	state.execute_parallel_over_pop([&](auto pops) {
+		auto age = ve::apply([&](dcon::pop_id pop) {
+			return (float)age_ticks(pop);
+		}, pops);
+		auto races = state.pop_get_race(pops);
+
+		auto teen_age = state.race_get_teen_age(races) * conversion;
+		auto adult_age = state.race_get_adult_age(races) * conversion;
+		auto middle_age = state.race_get_middle_age(races) * conversion;
+		auto max_age = state.race_get_max_age(races) * conversion;
+
+		auto multiplier = ve::select(
+			age < adult_age,
+			0.25f + 0.75f * age / adult_age,
+			ve::select(
+				age >= middle_age,
+				1.f - 0.1f * (age - middle_age) / (max_age - middle_age),
+				1.f
+			)
+		);
+		state.pop_set_cached_age_multiplier(pops, multiplier);
+		state.pop_set_cached_free_time(pops, ve::select(age < teen_age, age / teen_age, 1.f));
+
+		// deleted slots and lanes past the last pop stay invalid, ids reused later must not see stale values
+		ve::apply([&](dcon::pop_id pop) {
+			if (!state.pop_is_valid(pop)) {
+				state.pop_set_cached_age_valid(pop, 0);
+				return;
+			}
+			state.pop_set_cached_age_bracket(pop, compute_age_bracket(pop));
+			state.pop_set_cached_age_valid(pop, 1);
+		}, pops);
+	});
+}
+
+// tiles changed since the game window last took them for its map modes;
+// other binaries never take them, so the list is capped instead of growing without bound
+static std::mutex map_mode_changes_mutex;
+static std::vector<dcon::tile_id> map_mode_changed_tiles;
+static bool map_mode_all_tiles_changed = false;
+
+void map_mode_mark_tile(dcon::tile_id tile) {
+	if (!state.tile_is_valid(tile)) {
+		return;
+	}
+	std::lock_guard lock(map_mode_changes_mutex);
+	if (map_mode_all_tiles_changed) {
+		return;
+	}
+	// past a small share of the world a full upload is cheaper than many rectangles
+	if (map_mode_changed_tiles.size() >= state.tile_size() / 16) {
+		map_mode_all_tiles_changed = true;
+		map_mode_changed_tiles.clear();
+		return;
+	}
+	map_mode_changed_tiles.push_back(tile);
+}
+
+void map_mode_refresh() {
+	std::lock_guard lock(map_mode_changes_mutex);
+	map_mode_all_tiles_changed = true;
+	map_mode_changed_tiles.clear();
+}
+
+bool take_map_mode_changes(std::vector<dcon::tile_id>& tiles) {
+	std::lock_guard lock(map_mode_changes_mutex);
+	tiles.clear();
+	tiles.swap(map_mode_changed_tiles);
+	auto all = map_mode_all_tiles_changed;
+	map_mode_all_tiles_changed = false;
+	return all;
+}
+
+// the game window keeps the relief of the planet on the gpu
+static std::atomic<bool> elevation_changed { false };
+
+void elevation_refresh() {
+	elevation_changed = true;
+	// elevation is also a field of map modes
+	map_mode_refresh();
+}
+
+bool take_elevation_changes() {
+	return elevation_changed.exchange(false);
+}
+
 void update_vegetation(float speed) {
 	state.execute_serial_over_tile([speed](auto ids) {
 		auto conifer = state.tile_get_conifer(ids);
@@ -367,6 +1374,8 @@ void update_vegetation(float speed) {
 		state.tile_set_shrub(ids, shrub * (1.f - speed) + ideal_shrub * speed);
 		state.tile_set_grass(ids, grass * (1.f - speed) + ideal_grass * speed);
 	});
+	// every tile moves towards its ideal plants
+	map_mode_refresh();
 }
 
 template<typename T>
@@ -387,11 +1396,6 @@ ve::fp_vector get_permeability(T tile_id) {
 void apply_resource(int32_t resource_index) {
 	dcon::resource_fat_id res = dcon::fatten(state, dcon::resource_id{(dcon::resource_id::value_base_t)resource_index});
 
-	auto rng_engine = std::default_random_engine();
-	auto distribution = std::uniform_real_distribution<float> {0, 1};
-
-	auto generator = std::bind(distribution, rng_engine);
-
 	state.execute_parallel_over_tile([&](auto tiles) {
 		auto tile_is_land = state.tile_get_is_land(tiles);
 
@@ -474,9 +1478,7 @@ void apply_resource(int32_t resource_index) {
 
 		auto result = base_check && bedrock_check && biome_check;
 
-		auto dice_roll = ve::apply([&](auto tile) {
-			return generator() < 1.f / res.get_base_frequency();
-		}, tiles);
+		auto dice_roll = uniform_over(tiles, res.id.index()) < 1.f / res.get_base_frequency();
 
 		ve::value_to_vector_type<dcon::resource_id> current = state.tile_get_resource(tiles);
 		ve::value_to_vector_type<dcon::resource_id> candidate = res.id;
@@ -485,15 +1487,220 @@ void apply_resource(int32_t resource_index) {
 	});
 }
 
-void apply_biome(int32_t biome_index) {
-	dcon::biome_fat_id biome = dcon::fatten(state, dcon::biome_id{(uint8_t)biome_index});
-	assert(state.biome_is_valid(biome));
+// resource placement in one pass:
+// requirements which only compare ids or flags are folded into sets of candidate resources,
+// so a tile intersects a few sets and checks the remaining ranges for candidates only
+constexpr inline uint32_t RESOURCE_SET_WORDS = (300 + 63) / 64;
+
+struct resource_set {
+	uint64_t words[RESOURCE_SET_WORDS] = {};
+
+	void add(uint32_t index) {
+		words[index / 64] |= uint64_t(1) << (index % 64);
+	}
+	resource_set operator&(resource_set const& other) const {
+		resource_set result;
+		for (uint32_t i = 0; i < RESOURCE_SET_WORDS; i++) {
+			result.words[i] = words[i] & other.words[i];
+		}
+		return result;
+	}
+	resource_set operator~() const {
+		resource_set result;
+		for (uint32_t i = 0; i < RESOURCE_SET_WORDS; i++) {
+			result.words[i] = ~words[i];
+		}
+		return result;
+	}
+};
+
+struct resource_placement_table {
+	// index 0 holds tiles without bedrock or biome
+	std::vector<resource_set> by_bedrock;
+	std::vector<resource_set> by_biome;
+	resource_set land;
+	resource_set water;
+	resource_set coastal;
+	resource_set ice_age;
+
+	std::vector<float> minimum_elevation;
+	std::vector<float> maximum_elevation;
+	std::vector<float> minimum_trees;
+	std::vector<float> maximum_trees;
+	std::vector<float> chance;
+};
+
+resource_placement_table make_resource_placement_table() {
+	resource_placement_table table;
+	auto resource_count = state.resource_size();
+	assert(resource_count <= RESOURCE_SET_WORDS * 64);
+
+	table.by_bedrock.resize(state.bedrock_size() + 1);
+	table.by_biome.resize(state.biome_size() + 1);
+	table.minimum_elevation.resize(resource_count);
+	table.maximum_elevation.resize(resource_count);
+	table.minimum_trees.resize(resource_count);
+	table.maximum_trees.resize(resource_count);
+	table.chance.resize(resource_count);
+
+	state.for_each_resource([&](dcon::resource_id id) {
+		auto res = dcon::fatten(state, id);
+		auto index = (uint32_t)id.index();
+
+		if (res.get_land()) table.land.add(index);
+		if (res.get_water()) table.water.add(index);
+		if (res.get_coastal()) table.coastal.add(index);
+		if (res.get_ice_age()) table.ice_age.add(index);
+
+		if (!res.get_required_bedrock(0)) {
+			for (auto& set : table.by_bedrock) set.add(index);
+		}
+		for (int i = 0; i < state.resource_get_required_bedrock_size(); i++) {
+			auto requirement = state.resource_get_required_bedrock(id, i);
+			if (!requirement) {
+				break;
+			}
+			table.by_bedrock[requirement.index() + 1].add(index);
+		}
+
+		if (!res.get_required_biome(0)) {
+			for (auto& set : table.by_biome) set.add(index);
+		}
+		for (int i = 0; i < state.resource_get_required_biome_size(); i++) {
+			auto requirement = state.resource_get_required_biome(id, i);
+			if (!requirement) {
+				break;
+			}
+			table.by_biome[requirement.index() + 1].add(index);
+		}
+
+		table.minimum_elevation[index] = res.get_minimum_elevation();
+		table.maximum_elevation[index] = res.get_maximum_elevation();
+		table.minimum_trees[index] = res.get_minimum_trees();
+		table.maximum_trees[index] = res.get_maximum_trees();
+		table.chance[index] = 1.f / res.get_base_frequency();
+	});
+
+	return table;
+}
+
+// same result as calling apply_resource for every resource in id order
+void apply_all_resources() {
+	auto table = make_resource_placement_table();
+
+	state.execute_parallel_over_tile([&table](auto tiles) {
+		ve::apply([&](dcon::tile_id tile) {
+			auto candidates =
+				table.by_bedrock[state.tile_get_bedrock(tile).index() + 1]
+				& table.by_biome[state.tile_get_biome(tile).index() + 1]
+				& (state.tile_get_is_land(tile) ? table.land : table.water);
+			if (!state.tile_get_is_coast(tile)) {
+				candidates = candidates & ~table.coastal;
+			}
+			if (!(state.tile_get_ice_age_ice(tile) > 0)) {
+				candidates = candidates & ~table.ice_age;
+			}
+
+			auto elevation = state.tile_get_elevation(tile);
+			auto trees = state.tile_get_conifer(tile) + state.tile_get_broadleaf(tile);
+			auto result = state.tile_get_resource(tile);
+
+			for (uint32_t word = 0; word < RESOURCE_SET_WORDS; word++) {
+				auto bits = candidates.words[word];
+				while (bits) {
+					auto index = word * 64 + (uint32_t)std::countr_zero(bits);
+					bits &= bits - 1;
+
+					if (
+						elevation <= table.maximum_elevation[index]
+						&& elevation >= table.minimum_elevation[index]
+						&& trees <= table.maximum_trees[index]
+						&& trees >= table.minimum_trees[index]
+						&& rng::uniform(WORLD_SEED, (uint64_t)tile.index(), index) < table.chance[index]
+					) {
+						result = dcon::resource_id{(dcon::resource_id::value_base_t)index};
+					}
+				}
+			}
+
+			state.tile_set_resource(tile, result);
+		}, tiles);
+	});
+}
 
-	state.execute_parallel_over_tile([&biome](auto ids) {
+// every biome tests the same derived tile features, so they are computed once per block
+// and each biome is reduced to a pair of bounds per feature
+enum biome_feature : uint8_t {
+	biome_feature_slope,
+	biome_feature_elevation,
+	biome_feature_sand,
+	biome_feature_clay,
+	biome_feature_silt,
+	biome_feature_shrubs,
+	biome_feature_grass,
+	biome_feature_trees,
+	biome_feature_dead_land,
+	biome_feature_conifer_fraction,
+	biome_feature_rain,
+	biome_feature_temperature,
+	biome_feature_summer_temperature,
+	biome_feature_winter_temperature,
+	biome_feature_available_water,
+	biome_feature_soil_depth,
+	biome_feature_soil_richness,
+	biome_feature_count
+};
+
+struct biome_rule {
+	dcon::biome_id id;
+	bool aquatic;
+	bool marsh;
+	bool icy;
+	float minimum[biome_feature_count];
+	float maximum[biome_feature_count];
+};
+
+biome_rule make_biome_rule(dcon::biome_id id) {
+	auto biome = dcon::fatten(state, id);
+	biome_rule rule {};
+	rule.id = id;
+	rule.aquatic = biome.get_aquatic();
+	rule.marsh = biome.get_marsh();
+	rule.icy = biome.get_icy();
+
+	auto bounds = [&](biome_feature feature, float minimum, float maximum) {
+		rule.minimum[feature] = minimum;
+		rule.maximum[feature] = maximum;
+	};
+	bounds(biome_feature_slope, biome.get_minimum_slope(), biome.get_maximum_slope());
+	bounds(biome_feature_elevation, biome.get_minimum_elevation(), biome.get_maximum_elevation());
+	bounds(biome_feature_sand, biome.get_minimum_sand(), biome.get_maximum_sand());
+	bounds(biome_feature_clay, biome.get_minimum_clay(), biome.get_maximum_clay());
+	bounds(biome_feature_silt, biome.get_minimum_silt(), biome.get_maximum_silt());
+	bounds(biome_feature_shrubs, biome.get_minimum_shrubs(), biome.get_maximum_shrubs());
+	bounds(biome_feature_grass, biome.get_minimum_grass(), biome.get_maximum_grass());
+	bounds(biome_feature_trees, biome.get_minimum_trees(), biome.get_maximum_trees());
+	bounds(biome_feature_dead_land, biome.get_minimum_dead_land(), biome.get_maximum_dead_land());
+	bounds(biome_feature_conifer_fraction, biome.get_minimum_conifer_fraction(), biome.get_maximum_conifer_fraction());
+	bounds(biome_feature_rain, biome.get_minimum_rain(), biome.get_maximum_rain());
+	bounds(biome_feature_temperature, biome.get_minimum_temperature(), biome.get_maximum_temperature());
+	bounds(biome_feature_summer_temperature, biome.get_minimum_summer_temperature(), biome.get_maximum_summer_temperature());
+	bounds(biome_feature_winter_temperature, biome.get_minimum_winter_temperature(), biome.get_maximum_winter_temperature());
+	bounds(biome_feature_available_water, biome.get_minimum_available_water(), biome.get_maximum_available_water());
+	bounds(biome_feature_soil_depth, biome.get_minimum_soil_depth(), biome.get_maximum_soil_depth());
+	bounds(biome_feature_soil_richness, biome.get_minimum_soil_richness(), biome.get_maximum_soil_richness());
+
+	return rule;
+}
 
-		auto trees = state.tile_get_broadleaf(ids) + state.tile_get_conifer(ids);
-		auto dead_land = 1 - trees - state.tile_get_shrub(ids) - state.tile_get_grass(ids);
-		auto conifer_fraction = ve::select(trees == 0, 0.5f, state.tile_get_conifer(ids) / trees);
+// rules are tested in order and the last matching one wins,
+// same as calling apply_biome for each of them in turn
+void classify_biomes(std::vector<biome_rule> const& rules) {
+	state.execute_parallel_over_tile([&rules](auto ids) {
+		ve::fp_vector feature[biome_feature_count];
+
+		auto conifer = state.tile_get_conifer(ids);
+		auto trees = state.tile_get_broadleaf(ids) + conifer;
 
 		auto jan_temp = state.tile_get_january_temperature(ids);
 		auto jan_rain = state.tile_get_january_rain(ids);
@@ -501,182 +1708,66 @@ void apply_biome(int32_t biome_index) {
 		auto jul_rain = state.tile_get_july_temperature(ids);
 
 		auto rain = (jan_rain + jul_rain) * 0.5f;
-		auto temperature = (jan_temp + jul_temp) / 2;
-		auto summer_temperature = ve::max(jan_temp, jul_temp);
-		auto winter_temperature = ve::min(jan_temp, jul_temp);
 
-		auto permeability = get_permeability(ids);
+		feature[biome_feature_slope] = state.tile_get_slope(ids);
+		feature[biome_feature_elevation] = state.tile_get_elevation(ids);
+		feature[biome_feature_sand] = state.tile_get_sand(ids);
+		feature[biome_feature_clay] = state.tile_get_clay(ids);
+		feature[biome_feature_silt] = state.tile_get_silt(ids);
+		feature[biome_feature_shrubs] = state.tile_get_shrub(ids);
+		feature[biome_feature_grass] = state.tile_get_grass(ids);
+		feature[biome_feature_trees] = trees;
+		feature[biome_feature_dead_land] = 1 - trees - feature[biome_feature_shrubs] - feature[biome_feature_grass];
+		feature[biome_feature_conifer_fraction] = ve::select(trees == 0, 0.5f, conifer / trees);
+		feature[biome_feature_rain] = rain;
+		feature[biome_feature_temperature] = (jan_temp + jul_temp) / 2;
+		feature[biome_feature_summer_temperature] = ve::max(jan_temp, jul_temp);
+		feature[biome_feature_winter_temperature] = ve::min(jan_temp, jul_temp);
+		feature[biome_feature_available_water] = rain * 2 * get_permeability(ids);
+		feature[biome_feature_soil_depth] = feature[biome_feature_sand] + feature[biome_feature_silt] + feature[biome_feature_clay];
+		feature[biome_feature_soil_richness] = state.tile_get_soil_minerals(ids);
+
+		ve::mask_vector is_land = state.tile_get_is_land(ids);
+		ve::mask_vector has_marsh = state.tile_get_has_marsh(ids);
+		ve::mask_vector is_icy = state.tile_get_ice(ids) > 0.001f;
+
+		ve::value_to_vector_type<dcon::biome_id> result = state.tile_get_biome(ids);
+
+		for (auto& rule : rules) {
+			ve::mask_vector biome_mask = rule.aquatic ? !is_land : is_land;
+			biome_mask = biome_mask && (rule.marsh ? has_marsh : !has_marsh);
+			biome_mask = biome_mask && (rule.icy ? is_icy : !is_icy);
+
+			for (int i = 0; i < biome_feature_count; i++) {
+				biome_mask = biome_mask && (feature[i] > rule.minimum[i]) && (feature[i] < rule.maximum[i]);
+			}
 
-		auto available_water = rain * 2 * permeability;
+			ve::value_to_vector_type<dcon::biome_id> candidate = rule.id;
+			result = ve::select(biome_mask, candidate, result);
+		}
 
-		auto soil_depth = state.tile_get_sand(ids) + state.tile_get_silt(ids) + state.tile_get_clay(ids);
+		state.tile_set_biome(ids, result);
+	});
+	map_mode_refresh();
+}
 
-		ve::mask_vector biome_mask =
-			(
-				(
-					(
-						(
-							(
-								state.tile_get_slope(ids) > biome.get_minimum_slope()
-							&&
-								state.tile_get_slope(ids) < biome.get_maximum_slope()
-							)
-						&&
-							(
-								state.tile_get_is_land(ids) != biome.get_aquatic()
-							&&
-								state.tile_get_has_marsh(ids) == biome.get_marsh()
-							)
-						)
-					&&
-						(
-							(
-								state.tile_get_elevation(ids) > biome.get_minimum_elevation()
-							&&
-								state.tile_get_elevation(ids) < biome.get_maximum_elevation()
-							)
-						&&
-							(
-								state.tile_get_sand(ids) > biome.get_minimum_sand()
-							&&
-								state.tile_get_sand(ids) < biome.get_maximum_sand()
-							)
-						)
-					)
-				&&
-					(
-						(
-							(
-								state.tile_get_clay(ids) > biome.get_minimum_clay()
-							&&
-								state.tile_get_clay(ids) < biome.get_maximum_clay()
-							)
-						&&
-							(
-								state.tile_get_silt(ids) > biome.get_minimum_silt()
-							&&
-								state.tile_get_silt(ids) < biome.get_maximum_silt()
-							)
-						)
-					&&
-						(
-							(
-								state.tile_get_shrub(ids) > biome.get_minimum_shrubs()
-							&&
-								state.tile_get_shrub(ids) < biome.get_maximum_shrubs()
-							)
-						&&
-							(
-								state.tile_get_grass(ids) > biome.get_minimum_grass()
-							&&
-								state.tile_get_grass(ids) < biome.get_maximum_grass()
-							)
-						)
-					)
-				)
-			&&
-				(
-					(
-						(
-							(
-								trees > biome.get_minimum_trees()
-							&&
-								trees < biome.get_maximum_trees()
-							)
-						&&
-							(
-								dead_land > biome.get_minimum_dead_land()
-							&&
-								dead_land < biome.get_maximum_dead_land()
-							)
-						)
-					&&
-						(
-							(
-								conifer_fraction > biome.get_minimum_conifer_fraction()
-							&&
-								conifer_fraction < biome.get_maximum_conifer_fraction()
-							)
-						&&
-							(
-								rain > biome.get_minimum_rain()
-							&&
-								rain < biome.get_maximum_rain()
-							)
-						)
-					)
-				&&
-					(
-						(
-							(
-								temperature > biome.get_minimum_temperature()
-							&&
-								temperature < biome.get_maximum_temperature()
-							)
-						&&
-							(
-								summer_temperature > biome.get_minimum_summer_temperature()
-							&&
-								summer_temperature < biome.get_maximum_summer_temperature()
-							)
-						)
-					&&
-						(
-							(
-								winter_temperature > biome.get_minimum_winter_temperature()
-							&&
-								winter_temperature < biome.get_maximum_winter_temperature()
-							)
-						// &&
-						// 	(
-						// 		state.tile_get_shrub(ids) > biome.get_minimum_grass()
-						// 	&&
-						// 		state.tile_get_shrub(ids) < biome.get_maximum_grass()
-						// 	)
-						)
-					)
-				)
-			)
-		&&
-			(
-				(
-					(
-						(
-							available_water > biome.get_minimum_available_water()
-						)
-						&&
-						(
-							available_water < biome.get_maximum_available_water()
-						)
-					)
-					&&
-					(
-						(
-							soil_depth > biome.get_minimum_soil_depth()
-						)
-						&&
-						(
-							soil_depth < biome.get_maximum_soil_depth()
-						)
-					)
-				)
-				&&
-				(
-					(
-						state.tile_get_soil_minerals(ids) > biome.get_minimum_soil_richness()
-						&&
-						state.tile_get_soil_minerals(ids) < biome.get_maximum_soil_richness()
-					)
-					&&
-					biome.get_icy() == (state.tile_get_ice(ids) > 0.001)
-				)
-			);
+void apply_biome(int32_t biome_index) {
+	dcon::biome_id biome {(uint8_t)biome_index};
+	assert(state.biome_is_valid(biome));
 
-		ve::value_to_vector_type<dcon::biome_id> current = state.tile_get_biome(ids);
-		ve::value_to_vector_type<dcon::biome_id> candidate = biome.id;
+	classify_biomes({ make_biome_rule(biome) });
+}
 
-		state.tile_set_biome(ids, ve::select(biome_mask, candidate, current));
-	});
+void apply_all_biomes(int32_t const* load_order, uint32_t count) {
+	std::vector<biome_rule> rules;
+	rules.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		dcon::biome_id biome {(uint8_t)load_order[i]};
+		assert(state.biome_is_valid(biome));
+		rules.push_back(make_biome_rule(biome));
+	}
+
+	classify_biomes(rules);
 }
 
 float price_score(float price) {
@@ -686,78 +1777,236 @@ ve::fp_vector price_score(ve::fp_vector price) {
 	return ve::min(1.f, 1000.f / price);
 }
 
-void pops_consume() {
-	static auto uses_buffer = state.trade_good_category_make_vectorizable_float_buffer();
+void update_use_case_table() {
+	auto use_cases = state.use_case_size();
+	use_weights.offset.resize(use_cases + 1);
+	use_weights.good_consumption.resize(use_cases);
+	use_weights.trade_good.clear();
+	use_weights.weight.clear();
+	for (uint32_t i = 0; i < use_cases; i++) {
+		dcon::use_case_id use { dcon::use_case_id::value_base_t(i) };
+		use_weights.offset[i] = (uint32_t)use_weights.trade_good.size();
+		use_weights.good_consumption[i] = state.use_case_get_good_consumption(use);
+		state.use_case_for_each_use_weight_as_use_case(use, [&](auto weight_id) {
+			use_weights.trade_good.push_back(state.use_weight_get_trade_good(weight_id));
+			use_weights.weight.push_back(state.use_weight_get_weight(weight_id));
+		});
+	}
+	use_weights.offset[use_cases] = (uint32_t)use_weights.trade_good.size();
+	use_weights.valid = true;
+
+	check_inventory_mask_capacity();
+}
+
+const use_case_table& get_use_case_table() {
+	if (!use_weights.valid) {
+		update_use_case_table();
+	}
+	return use_weights;
+}
+
+// use cases created after the table was built would read past its spans
+bool is_table_use_case(const use_case_table& table, dcon::use_case_id use_case) {
+	return state.use_case_is_valid(use_case) && use_case.index() + 1 < int32_t(table.offset.size());
+}
+
+// this tree has no local markets: the price of a use is estimated from base prices of trade goods,
+// so it is the same everywhere
+float estimate_use_price(dcon::use_case_id use_case) {
+	auto& table = get_use_case_table();
+	if (!is_table_use_case(table, use_case)) return 0.f;
+	auto begin = table.offset[use_case.index()];
+	auto end = table.offset[use_case.index() + 1];
+	if (begin == end) return 0.f;
+
+	auto min_price = std::numeric_limits<float>::max();
+	for (auto w = begin; w < end; w++) {
+		min_price = std::min(min_price, state.trade_good_get_base_price(table.trade_good[w]));
+	}
+
+	auto sum_of_exponents = 0.f;
+	for (auto w = begin; w < end; w++) {
+		sum_of_exponents += expf(-state.trade_good_get_base_price(table.trade_good[w]) + min_price);
+	}
+
+	auto total_cost = 0.f;
+	for (auto w = begin; w < end; w++) {
+		auto price = state.trade_good_get_base_price(table.trade_good[w]);
+		auto prob_density = expf(-price + min_price) / sum_of_exponents;
+		auto bought = 1.f / table.weight[w] * prob_density;
+		total_cost += bought * price;
+	}
+	return total_cost;
+}
+
+// weighted storage of goods of a use in one settlement
+float estimate_settlement_use_available(dcon::settlement_id settlement, dcon::use_case_id use_case) {
+	if (!state.settlement_is_valid(settlement)) return 0.f;
+	auto& table = get_use_case_table();
+	if (!is_table_use_case(table, use_case)) return 0.f;
+	auto total = 0.f;
+	for (auto w = table.offset[use_case.index()]; w < table.offset[use_case.index() + 1]; w++) {
+		total += state.settlement_get_local_storage(settlement, table.trade_good[w]) * table.weight[w];
+	}
+	return total;
+}
+
+// children of a household head which are touched during consumption
+struct household_member {
+	dcon::pop_id child;
+	// shares inventory and demand with the head
+	bool dependent;
+	// receives satisfaction of the head
+	bool young;
+};
+
+struct household_batch {
+	std::vector<dcon::pop_id> head;
+	std::vector<uint32_t> member_offset;
+	std::vector<household_member> members;
+	// heads grouped by settlement, in pop id order
+	std::vector<std::vector<uint32_t>> per_settlement;
+	// heads which interact with pops outside of their settlement
+	std::vector<uint32_t> serial;
+	std::vector<uint8_t> entangled;
+};
+
+static household_batch households;
+
+// groups every pop which is not a dependent with its children once per tick
+// settlements which share a household with another settlement are marked as entangled
+// and processed serially to keep the result identical to a plain loop over pops
+void collect_households() {
+	households.head.clear();
+	households.member_offset.clear();
+	households.members.clear();
+	households.serial.clear();
+	households.per_settlement.resize(state.settlement_size());
+	for (auto& bucket : households.per_settlement) {
+		bucket.clear();
+	}
+	households.entangled.assign(state.settlement_size(), 0);
+
+	std::vector<dcon::settlement_id> head_location;
 
-	state.for_each_pop([&](auto pop){
+	state.for_each_pop([&](auto pop) {
 		if (is_dependent(pop)) return;
 
-		// std::cout << "pop: " << pop.index();
+		auto location = state.pop_location_get_location(state.pop_get_pop_location_as_pop(pop));
 
-		for (uint32_t i = 0; i < state.pop_get_need_satisfaction_size(); i++) {
-			base_types::need_satisfaction& need = state.pop_get_need_satisfaction(pop, i);
-			// std::cout << "need: " << i << " " << need.use_case;
-
-			if (need.use_case == 0)	break;
-
-			auto demanded = need.demanded;
-
-			auto use = dcon::use_case_id{dcon::use_case_id::value_base_t(need.use_case - 1)};
-
-			state.pop_for_each_parent_child_relation_as_parent(pop, [&](auto child_rel) {
-				auto child = state.parent_child_relation_get_child(child_rel);
-				if (is_dependent_of(pop,child)) {
-					base_types::need_satisfaction& need_child = state.pop_get_need_satisfaction(child, i);
-					demanded += need_child.demanded;
-					// transfer half of relevent trade goods for collective satisfaction
-					state.use_case_for_each_use_weight_as_use_case(use, [&](auto weight_id){
-						auto trade_good = state.use_weight_get_trade_good(weight_id);
-						auto amount = state.pop_get_inventory(child,trade_good);
-						state.pop_set_inventory(child,trade_good,amount*0.5);
-						state.pop_set_inventory(pop,trade_good,state.pop_get_inventory(pop,trade_good)+amount*0.5);
-					});
-				}
-			});
-
-
-			auto actual_consumption_rate = state.use_case_get_good_consumption(use);
-			auto satisfied = 0.f;
-
-			state.use_case_for_each_use_weight_as_use_case(use, [&](auto weight_id){
-				auto weight = state.use_weight_get_weight(weight_id);
-				auto trade_good = state.use_weight_get_trade_good(weight_id);
-
-				auto inventory = state.pop_get_inventory(pop, trade_good);
-				auto can_consume = inventory * weight;
-
-				if (satisfied >= demanded) {
-					return;
-				} else if (satisfied + can_consume > demanded) {
-					auto consumed = (demanded - satisfied) / weight * actual_consumption_rate;
-					state.pop_set_inventory(pop, trade_good, std::max(0.f, inventory - consumed));
-					satisfied = demanded;
-					return;
-				} else {
-					satisfied += can_consume;
-					auto consumed = inventory * actual_consumption_rate;
-					state.pop_set_inventory(pop, trade_good, std::max(0.f, inventory - consumed));
-				}
-			});
-
-			auto satisfaction = satisfied / demanded;
-
-			need.consumed = need.demanded * satisfaction;
-			state.pop_for_each_parent_child_relation_as_parent(pop, [&](auto child_rel) {
-				auto child = state.parent_child_relation_get_child(child_rel);
-				auto child_age = age_years(child);
-				auto teen_age = state.race_get_teen_age(state.pop_get_race(child));
-				if (child_age < teen_age) {
-					base_types::need_satisfaction& need_child = state.pop_get_need_satisfaction(child, i);
-					need_child.consumed = need.demanded * satisfaction;
-				}
-			});
+		households.head.push_back(pop);
+		households.member_offset.push_back((uint32_t)households.members.size());
+		head_location.push_back(location);
+
+		state.pop_for_each_parent_child_relation_as_parent(pop, [&](auto child_rel) {
+			auto child = state.parent_child_relation_get_child(child_rel);
+			auto dependent = is_dependent_of(pop, child);
+			auto young = is_young(child);
+			if (!dependent && !young) return;
+
+			households.members.push_back({child, dependent, young});
+
+			auto child_location = state.pop_location_get_location(state.pop_get_pop_location_as_pop(child));
+			if (child_location != location) {
+				if (location) households.entangled[location.index()] = 1;
+				if (child_location) households.entangled[child_location.index()] = 1;
+			}
+		});
+	});
+	households.member_offset.push_back((uint32_t)households.members.size());
+
+	for (uint32_t i = 0; i < households.head.size(); i++) {
+		auto location = head_location[i];
+		if (location && !households.entangled[location.index()]) {
+			households.per_settlement[location.index()].push_back(i);
+		} else {
+			households.serial.push_back(i);
+		}
+	}
+}
+
+void household_consume(uint32_t household) {
+	auto pop = households.head[household];
+	auto members_begin = households.member_offset[household];
+	auto members_end = households.member_offset[household + 1];
+
+	for (uint32_t i = 0; i < state.pop_get_need_satisfaction_size(); i++) {
+		base_types::need_satisfaction& need = state.pop_get_need_satisfaction(pop, i);
+
+		if (need.use_case == 0)	break;
+
+		auto demanded = need.demanded;
+
+		auto use = dcon::use_case_id{dcon::use_case_id::value_base_t(need.use_case - 1)};
+		auto weights_begin = use_weights.offset[use.index()];
+		auto weights_end = use_weights.offset[use.index() + 1];
+
+		for (auto m = members_begin; m < members_end; m++) {
+			auto& member = households.members[m];
+			if (!member.dependent) continue;
+			auto child = member.child;
+			base_types::need_satisfaction& need_child = state.pop_get_need_satisfaction(child, i);
+			demanded += need_child.demanded;
+			// transfer half of relevent trade goods for collective satisfaction
+			for (auto w = weights_begin; w < weights_end; w++) {
+				auto trade_good = use_weights.trade_good[w];
+				if (!pop_may_hold(child, trade_good)) continue;
+				auto amount = state.pop_get_inventory(child,trade_good);
+				pop_set_inventory_tracked(child,trade_good,amount*0.5);
+				pop_set_inventory_tracked(pop,trade_good,state.pop_get_inventory(pop,trade_good)+amount*0.5);
+			}
+		}
+
+		auto actual_consumption_rate = use_weights.good_consumption[use.index()];
+		auto satisfied = 0.f;
+
+		for (auto w = weights_begin; w < weights_end; w++) {
+			auto weight = use_weights.weight[w];
+			auto trade_good = use_weights.trade_good[w];
+			if (!pop_may_hold(pop, trade_good)) continue;
+
+			auto inventory = state.pop_get_inventory(pop, trade_good);
+			auto can_consume = inventory * weight;
+
+			if (satisfied >= demanded) {
+				continue;
+			} else if (satisfied + can_consume > demanded) {
+				auto consumed = (demanded - satisfied) / weight * actual_consumption_rate;
+				pop_set_inventory_tracked(pop, trade_good, std::max(0.f, inventory - consumed));
+				satisfied = demanded;
+			} else {
+				satisfied += can_consume;
+				auto consumed = inventory * actual_consumption_rate;
+				pop_set_inventory_tracked(pop, trade_good, std::max(0.f, inventory - consumed));
+			}
+		}
+
+		auto satisfaction = satisfied / demanded;
+
+		need.consumed = need.demanded * satisfaction;
+		for (auto m = members_begin; m < members_end; m++) {
+			auto& member = households.members[m];
+			if (!member.young) continue;
+			base_types::need_satisfaction& need_child = state.pop_get_need_satisfaction(member.child, i);
+			need_child.consumed = need.demanded * satisfaction;
+		}
+	}
+}
+
+void pops_consume() {
+	get_use_case_table();
+	collect_households();
+
+	// settlements which are not entangled do not share pops with anyone
+	concurrency::parallel_for(uint32_t(0), (uint32_t)households.per_settlement.size(), [&](auto settlement_raw_id) {
+		for (auto household : households.per_settlement[settlement_raw_id]) {
+			household_consume(household);
 		}
 	});
+
+	for (auto household : households.serial) {
+		household_consume(household);
+	}
 }
 
 void pops_update_stats() {
@@ -802,93 +2051,141 @@ void pops_update_stats() {
 }
 
 auto WORKERS_SHARE = 0.01f;
-// estates can interact only with local pops
-// can do in parallel over settlements
-void estates_pay() {
-	state.for_each_estate([&](auto estate) {
-		auto savings = state.estate_get_savings(estate);
 
-		auto wage_budget = savings * WORKERS_SHARE;
-		state.estate_get_balance_last_tick(estate) -= wage_budget;
-
-		float total_work_time = 0.f;
-		state.estate_for_each_building_estate(estate, [&](auto building_location) {
-			auto building = state.building_estate_get_building(building_location);
-			auto worker = state.building_get_worker_from_employment(building);
-			if (worker) {
-				total_work_time += state.pop_get_work_ratio(worker);
-			}
-		});
+struct wage_entry {
+	dcon::building_id building;
+	dcon::pop_id worker;
+	float work_ratio;
+};
 
-		if (total_work_time < 0.01f) {
-			return;
+// employment is unique on the worker side, so estates never pay the same pop
+void estate_pay(dcon::estate_id estate, std::vector<wage_entry>& workers) {
+	auto savings = state.estate_get_savings(estate);
+
+	auto wage_budget = savings * WORKERS_SHARE;
+	state.estate_get_balance_last_tick(estate) -= wage_budget;
+
+	workers.clear();
+	float total_work_time = 0.f;
+	state.estate_for_each_building_estate(estate, [&](auto building_location) {
+		auto building = state.building_estate_get_building(building_location);
+		auto worker = state.building_get_worker_from_employment(building);
+		if (worker) {
+			auto work_ratio = state.pop_get_work_ratio(worker);
+			total_work_time += work_ratio;
+			workers.push_back({building, worker, work_ratio});
 		}
-
-		state.estate_for_each_building_estate(estate, [&](auto building_location) {
-			auto building = state.building_estate_get_building(building_location);
-			auto worker = state.building_get_worker_from_employment(building);
-			if (worker) {
-				auto work_ratio = state.pop_get_work_ratio(worker);
-				auto share = wage_budget * work_ratio / total_work_time;
-				state.pop_get_pending_economy_income(worker) += share;
-				state.building_set_worker_income_from_employment(building, share);
-			}
-		});
 	});
-}
 
-// TODO: rewrite more stuff to parallel loops, as there are a lot of opportunities for parallelisation
-void update_economy() {
-	uint32_t trade_goods_count = state.trade_good_size();
+	if (total_work_time < 0.01f) {
+		return;
+	}
 
-	state.execute_serial_over_estate([&](auto estates) {
-		state.estate_set_balance_last_tick(estates, 0.f);
-	});
-	concurrency::parallel_for(uint32_t(0), state.trade_good_size(), [&](auto trade_good_raw_id) {
-		dcon::trade_good_id trade_good { dcon::trade_good_id::value_base_t(trade_good_raw_id) };
-		if (!state.trade_good_is_valid(trade_good)) return;
-		state.execute_serial_over_estate([&](auto estates) {
-			state.estate_set_inventory_demanded_last_tick(estates, trade_good, 0.f);
-			state.estate_set_inventory_sold_last_tick(estates, trade_good, 0.f);
-			state.estate_set_inventory_bought_last_tick(estates, trade_good, 0.f);
+	for (auto& entry : workers) {
+		auto share = wage_budget * entry.work_ratio / total_work_time;
+		state.pop_get_pending_economy_income(entry.worker) += share;
+		state.building_set_worker_income_from_employment(entry.building, share);
+	}
+}
+
+// estates can interact only with local pops
+void estates_pay() {
+	concurrency::parallel_for(uint32_t(0), state.settlement_size(), [&](auto settlement_raw_id) {
+		dcon::settlement_id settlement { dcon::settlement_id::value_base_t(settlement_raw_id) };
+		if (!state.settlement_is_valid(settlement)) return;
+		static thread_local std::vector<wage_entry> workers;
+		state.settlement_for_each_estate_location(settlement, [&](auto estate_location) {
+			estate_pay(state.estate_location_get_estate(estate_location), workers);
 		});
 	});
 
-	// update pops self value
-	state.execute_serial_over_pop([&](auto pops) {
-		state.pop_set_expected_wage(pops, ve::max(state.pop_get_savings(pops) * 0.01f, state.pop_get_expected_wage(pops)));
+	// estates without location
+	std::vector<wage_entry> workers;
+	state.for_each_estate([&](auto estate) {
+		if (state.estate_get_settlement_from_estate_location(estate)) return;
+		estate_pay(estate, workers);
 	});
+}
 
-	auto eps = 0.001f;
-	const float pop_donation = 0.05f;
+// decays inventories of pops, estates, settlements and realms and resets estate trade statistics
+// every block of entities goes through all trade goods before the next block is loaded
+// goods which do not decay are skipped
+void decay_inventories() {
+	static std::vector<dcon::trade_good_id> trade_goods;
+	static std::vector<float> decay;
+	trade_goods.clear();
+	decay.clear();
 
-	// decay inventories of producers
-	concurrency::parallel_for(uint32_t(0), trade_goods_count, [&](auto good_id){
-		dcon::trade_good_id trade_good{ dcon::trade_good_id::value_base_t(good_id) };
-		float inventory_decay = state.trade_good_get_decay(trade_good);
-		state.execute_serial_over_pop([&](auto ids){
-			auto inventory = state.pop_get_inventory(ids, trade_good);
-			state.pop_set_inventory(ids, trade_good, inventory * inventory_decay);
-		});
-		state.execute_serial_over_estate([&](auto ids){
+	uint32_t trade_goods_count = state.trade_good_size();
+	for (uint32_t i = 0; i < trade_goods_count; i++) {
+		dcon::trade_good_id trade_good { dcon::trade_good_id::value_base_t(i) };
+		if (!state.trade_good_is_valid(trade_good)) continue;
+		trade_goods.push_back(trade_good);
+		decay.push_back(state.trade_good_get_decay(trade_good));
+	}
+	auto goods = trade_goods.size();
+
+	state.execute_parallel_over_estate([&](auto ids) {
+		state.estate_set_balance_last_tick(ids, 0.f);
+		for (size_t i = 0; i < goods; i++) {
+			auto trade_good = trade_goods[i];
+			state.estate_set_inventory_demanded_last_tick(ids, trade_good, 0.f);
+			state.estate_set_inventory_sold_last_tick(ids, trade_good, 0.f);
+			state.estate_set_inventory_bought_last_tick(ids, trade_good, 0.f);
+			if (decay[i] == 1.f) continue;
 			auto inventory = state.estate_get_inventory(ids, trade_good);
-			state.estate_set_inventory(ids, trade_good, inventory * inventory_decay);
-		});
+			state.estate_set_inventory(ids, trade_good, inventory * decay[i]);
+		}
 	});
 
-	// decay inventories in settlements and realms:
-	concurrency::parallel_for(uint32_t(0), trade_goods_count, [&](auto good_id){
-		dcon::trade_good_id trade_good{ dcon::trade_good_id::value_base_t(good_id) };
-		float inventory_decay = state.trade_good_get_decay(trade_good);
-		state.execute_serial_over_settlement([&](auto ids){
-			auto stockpiles = state.settlement_get_local_storage(ids, trade_good);
-			state.settlement_set_local_storage(ids, trade_good, stockpiles * inventory_decay);
-		});
-		state.execute_serial_over_realm([&](auto ids){
-			auto stockpiles = state.realm_get_resources(ids, trade_good);
-			state.realm_set_resources(ids, trade_good, stockpiles * inventory_decay);
-		});
+	state.execute_parallel_over_pop([&](auto ids) {
+		// update pops self value
+		state.pop_set_expected_wage(ids, ve::max(state.pop_get_savings(ids) * 0.01f, state.pop_get_expected_wage(ids)));
+		if (!SPARSE_INVENTORY) {
+			for (size_t i = 0; i < goods; i++) {
+				if (decay[i] == 1.f) continue;
+				auto inventory = state.pop_get_inventory(ids, trade_goods[i]);
+				state.pop_set_inventory(ids, trade_goods[i], inventory * decay[i]);
+			}
+			return;
+		}
+		// Lua writes inventories directly, so masks are rebuilt here from the decayed values
+		ve::apply([&](dcon::pop_id pop) {
+			state.pop_set_inventory_mask_low(pop, 0);
+			state.pop_set_inventory_mask_high(pop, 0);
+		}, ids);
+		for (size_t i = 0; i < goods; i++) {
+			auto trade_good = trade_goods[i];
+			auto inventory = state.pop_get_inventory(ids, trade_good);
+			if (decay[i] != 1.f) {
+				inventory = inventory * decay[i];
+				state.pop_set_inventory(ids, trade_good, inventory);
+			}
+			ve::apply([&](dcon::pop_id pop, float value) {
+				if (value != 0.f) pop_mark_inventory(pop, trade_good, true);
+			}, ids, inventory);
+		}
+	});
+
+	state.execute_parallel_over_settlement([&](auto ids) {
+		for (size_t i = 0; i < goods; i++) {
+			if (decay[i] == 1.f) continue;
+			auto stockpiles = state.settlement_get_local_storage(ids, trade_goods[i]);
+			state.settlement_set_local_storage(ids, trade_goods[i], stockpiles * decay[i]);
+		}
+	});
+
+	state.execute_parallel_over_realm([&](auto ids) {
+		for (size_t i = 0; i < goods; i++) {
+			if (decay[i] == 1.f) continue;
+			auto stockpiles = state.realm_get_resources(ids, trade_goods[i]);
+			state.realm_set_resources(ids, trade_goods[i], stockpiles * decay[i]);
+		}
 	});
+}
+
+void update_economy() {
+	decay_inventories();
 
 	pops_consume();
 	estates_pay();
@@ -2,18 +2,39 @@
 
 #pragma once
 #include <stdint.h>
+#include <vector>
 #include "data.hpp"
 #include "export_ifdefs.hpp"
 
 extern dcon::data_container state;
 
+// loads only the sections enabled in selection and reports which of them were present
+dcon::load_record load_state_selective(char const* name, dcon::load_record const& selection, bool sparse);
+void record_skip_climate_cells(dcon::load_record& record);
+
+// steps of update_economy, exposed for benchmarks
+void decay_inventories();
+void pops_consume();
+void estates_pay();
+void pops_update_stats();
+
+// tiles marked by map_mode_mark_tile since the last call;
+// returns true instead when every tile has to be redrawn
+bool take_map_mode_changes(std::vector<dcon::tile_id>& tiles);
+// true once after elevation_refresh
+bool take_elevation_changes();
+
 extern "C" {
 	DCON_LUADLL_API void update_vegetation(float);
 	DCON_LUADLL_API void apply_biome(int32_t);
+	DCON_LUADLL_API void apply_all_biomes(int32_t const* load_order, uint32_t count);
 	DCON_LUADLL_API void apply_resource(int32_t);
+	DCON_LUADLL_API void apply_all_resources();
 	DCON_LUADLL_API void update_economy();
-	DCON_LUADLL_API float estimate_province_use_price(uint32_t, uint32_t);
-	DCON_LUADLL_API float estimate_province_use_available(uint32_t, uint32_t);
+	DCON_LUADLL_API float estimate_use_price(dcon::use_case_id);
+	DCON_LUADLL_API float estimate_settlement_use_available(dcon::settlement_id, dcon::use_case_id);
+	DCON_LUADLL_API void update_use_case_table();
+	DCON_LUADLL_API bool set_sparse_inventory(bool);
 	DCON_LUADLL_API float estimate_building_type_income(int32_t, int32_t, int32_t, bool);
 	DCON_LUADLL_API int32_t roll_desired_building_type_for_pop(int32_t);
 	DCON_LUADLL_API void update_foraging_data(
@@ -33,12 +54,30 @@ extern "C" {
 	);
 
 	DCON_LUADLL_API void load_state(char const*);
+	DCON_LUADLL_API void load_state_without_climate(char const*);
+	DCON_LUADLL_API void save_state(char const*);
+	DCON_LUADLL_API void save_state_snapshot(char const*);
+	DCON_LUADLL_API void wait_for_saves();
+	DCON_LUADLL_API void set_save_compression(bool);
+	DCON_LUADLL_API bool save_state_delta(char const*);
+	DCON_LUADLL_API bool load_state_with_delta(char const* base, char const* delta);
+	DCON_LUADLL_API bool compact_state(char const* base, char const* delta, char const* output);
+	DCON_LUADLL_API bool load_world_cache(char const* name, uint64_t fingerprint);
+	DCON_LUADLL_API bool save_world_cache(char const* name, uint64_t fingerprint);
 	DCON_LUADLL_API void update_map_mode_pointer(uint8_t* map, uint32_t world_size);
+	// redraws one tile, or every tile, in the map modes of the game window
+	DCON_LUADLL_API void map_mode_mark_tile(dcon::tile_id tile);
+	DCON_LUADLL_API void map_mode_refresh();
+	// uploads the relief again, and redraws map modes, after elevation of tiles changed
+	DCON_LUADLL_API void elevation_refresh();
 	// DCON_LUADLL_API int32_t get_neighbor(int32_t tile_id, uint8_t neighbor_index, uint32_t world_size);
 
 	DCON_LUADLL_API void ai_update_price_belief(int32_t trader_raw_id);
 	DCON_LUADLL_API void ai_trade(int32_t trader_raw_id);
 
+	DCON_LUADLL_API void set_world_seed(uint64_t seed);
+	DCON_LUADLL_API uint64_t get_world_seed(void);
+
 	// backend time tracking
 	DCON_LUADLL_API void set_world_current_year(uint32_t year);
 	DCON_LUADLL_API uint32_t get_world_current_year(void);
@@ -65,8 +104,12 @@ extern "C" {
 	DCON_LUADLL_API float pop_warband_time(dcon::pop_id pop,float free);
 	DCON_LUADLL_API float pop_forage_time(dcon::pop_id pop,float free,float party);
 	DCON_LUADLL_API float pop_work_time(dcon::pop_id pop,float free,float party,float forage);
+	DCON_LUADLL_API void pops_time_budget(dcon::pop_id const* pops, uint32_t count, float* free, float* party, float* forage, float* work);
+	DCON_LUADLL_API void pops_time_budget_all(float* free, float* party, float* forage, float* work);
 	// misc
 	DCON_LUADLL_API bool pop_same_location(dcon::pop_id,dcon::pop_id);
 	DCON_LUADLL_API bool is_dependent(dcon::pop_id child);
 	DCON_LUADLL_API bool is_dependent_of(dcon::pop_id child,dcon::pop_id parent);
+	DCON_LUADLL_API void update_pop_age_cache();
+	DCON_LUADLL_API void pop_reset_age_cache(dcon::pop_id pop);
 }
@@ -0,0 +1,720 @@
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include <glm/ext.hpp>
+
+#include "stb_image/stb_image.h"
+#include "unordered_dense.h"
+#include "rng.hpp"
+#include "sote_functions.hpp"
+#include "world_loading.hpp"
+
+glm::vec3 rgb_to_hsv(float r, float g, float b) {
+	auto max = std::max(r, std::max(g, b));
+	auto min = std::min(r, std::min(g, b));
+
+	auto h = 0;
+	if (max == min) {
+		h = 0;
+	} else if (max == r) {
+		h = fmod((g - b) * 60 / (max - min), 360.f);
+	} else if (max == g) {
+		h = fmod((b - r) * 60 / (max - min) + 120, 360.f);
+	} else if (max == b) {
+		h = fmod((r - g) * 60 / (max - min) + 240, 360.f);
+	}
+	float s = 0.f;
+	if (max != 0) s = 1 - min / max;
+
+	return {h, s, max};
+}
+
+int rgb_to_id(int r, int g, int b) {
+	return r + 256 * g + 256 * 256 * b;
+}
+
+glm::vec3 fst_to_sphere(int world_size, glm::ivec3 fst) {
+	int f =fst.x;
+	int s = fst.y;
+	int t = fst.z;
+	auto fs = (float(s) + 0.5f) / float(world_size);
+	auto ft = (float(t) + 0.5f) / float(world_size);
+	glm::vec3 ds;
+	glm::vec3 dt;
+	glm::vec3 origin;
+	if (f == 0) {
+		origin = cubeworld::top::origin;
+		dt = cubeworld::top::dt;
+		ds = cubeworld::top::ds;
+	} else if (f == 1) {
+		origin = cubeworld::bottom::origin;
+		dt = cubeworld::bottom::dt;
+		ds = cubeworld::bottom::ds;
+	} else if (f == 2) {
+		origin = cubeworld::left::origin;
+		dt = cubeworld::left::dt;
+		ds = cubeworld::left::ds;
+	} else if (f == 3) {
+		origin = cubeworld::right::origin;
+		dt = cubeworld::right::dt;
+		ds = cubeworld::right::ds;
+	} else if (f == 4) {
+		origin = cubeworld::forward::origin;
+		dt = cubeworld::forward::dt;
+		ds = cubeworld::forward::ds;
+	} else if (f == 5) {
+		origin = cubeworld::back::origin;
+		dt = cubeworld::back::dt;
+		ds = cubeworld::back::ds;
+	} else {
+		assert(false);
+		exit(1);
+	}
+
+	auto result = (origin + ds * fs + dt * ft);
+
+	return result / glm::length(result);
+}
+
+uint8_t sphere_to_face(glm::vec3 point) {
+	// we do it the most stupid way possible: find the closest +- basis vector
+	auto best_distance = 3.f;
+	auto best_face = 0;
+	for (int face = 0; face < 6; ++face) {
+		auto distance = glm::distance(point, face_to_center[face]);
+		if (distance < best_distance) {
+			best_face = face;
+			best_distance = distance;
+		}
+	}
+	return best_face;
+}
+
+glm::vec3 sphere_to_box(glm::vec3 point) {
+	auto face = sphere_to_face(point / glm::length(point));
+	auto center = face_to_center[face];
+	// move back to cube:
+	auto value = glm::dot(center, point);
+	auto box_side = point / value;
+	return box_side;
+}
+
+
+
+glm::ivec3 sphere_to_fst(int world_size, glm::vec3 point) {
+	auto face = sphere_to_face(point / glm::length(point));
+	auto center = face_to_center[face];
+	// move back to cube:
+	auto value = glm::dot(center, point);
+	auto box_side = point / value;
+	auto ratio = (box_side - face_to_origin[face]);
+	auto dual_dt = face_to_dt[face] / glm::dot(face_to_dt[face], face_to_dt[face]);
+	auto dual_ds = face_to_ds[face] / glm::dot(face_to_ds[face], face_to_ds[face]);
+	auto t = std::max(0.f, glm::dot(ratio, dual_dt) - 0.00001f) * world_size;
+	auto s = std::max(0.f, glm::dot(ratio, dual_ds) - 0.00001f) * world_size;
+	return {face, (int)(s), (int)(t)};
+}
+
+dcon::tile_id fst_to_tile(int world_size, glm::ivec3 fst ) {
+	return dcon::tile_id {(uint32_t) fst.x * world_size * world_size + fst.z * world_size + fst.y};
+}
+
+dcon::tile_id r3_to_tile(int world_size, glm::vec3 point) {
+	auto fst = sphere_to_fst(world_size, point / glm::length(point));
+	return fst_to_tile(world_size, fst);
+}
+
+glm::ivec3 tile_to_fst(int world_size, dcon::tile_id tile) {
+	auto index = tile.index();
+	auto face_size = world_size * world_size;
+	auto face = index / face_size;
+	auto st = index - face * face_size;
+	auto t = st / world_size;
+	auto s = st - t * world_size;
+
+	return {face, s, t};
+}
+
+glm::vec3 tile_to_sphere(int world_size, dcon::tile_id tile) {
+	auto index = tile.index();
+	auto face_size = world_size * world_size;
+	auto face = index / face_size;
+	auto st = index - face * face_size;
+	auto t = st / world_size;
+	auto s = st - t * world_size;
+	return fst_to_sphere(world_size, {face, s, t});
+}
+
+
+glm::vec2 sphere_to_rect(glm::vec3 point) {
+	auto d = glm::length(point);
+	auto y = acosf(point.y / d);
+	auto x = atan2f(point.z, point.x);
+	glm::vec2 res = {  x + glm::pi<float>() , y};
+	glm::vec2 scaling = { glm::pi<float>() * 2, glm::pi<float>()};
+	return res / scaling;
+}
+
+int rect_to_image_index(int width, int height, glm::vec2 point) {
+	int x = (int)((float)width * point.x);
+	int y = (int)((float)height * point.y);
+	return width * y + x;
+}
+
+bool color_is_land(uint8_t r, uint8_t g, uint8_t b) {
+	if (r == 30 && g == 125 && b == 255) {
+		return false;
+	}
+	if (r == 15 && g == 239 && b == 255) {
+		return false;
+	}
+	if (r == 2 && g == 8 && b == 209) {
+		return false;
+	}
+	return true;
+}
+
+bool color_is_fresh(uint8_t r, uint8_t g, uint8_t b) {
+	if (r == 15 && g == 239 && b == 255) {
+		return true;
+	}
+	return false;
+}
+
+static bool equals(uint8_t r, uint8_t g, uint8_t b, uint8_t r1, uint8_t g1, uint8_t b1) {
+	return r == r1 && g == g1 && b == b1;
+}
+
+float color_waterflow(uint8_t r, uint8_t g, uint8_t b) {
+	if (r == 30 && g == 125 && b == 255) {
+		return 0.f;
+	}
+	if (r == 15 && g == 239 && b == 255) {
+		return 0.f;
+	}
+	if (r == 2 && g == 8 && b == 209) {
+		return 0.f;
+	}
+	if (equals(r, g, b, 129, 9, 9)) {
+		return 0.f;
+	}
+	if (equals(r, g, b, 244, 17, 17)) {
+		return 800;
+	}
+	if (equals(r, g, b, 255, 132, 17)) {
+		return 2000;
+	}
+	if (equals(r, g, b, 250, 250, 10)) {
+		return 5259;
+	}
+	if (equals(r, g, b, 28, 255, 122)) {
+		return 11250;
+	}
+	if (equals(r, g, b, 15, 175, 255)) {
+		return 20000;
+	}
+	if (equals(r, g, b, 24, 77, 249)) {
+		return 30000;
+	}
+	return 0.f;
+}
+
+// tables live for the whole run and are shared by every image of the same size,
+// so reloading the world does not repeat the trigonometry
+static std::vector<std::unique_ptr<tile_pixel_table>> tile_pixel_cache;
+
+constexpr uint32_t tile_pixel_file_magic = 0x58495054; // "TPIX"
+constexpr uint32_t tile_pixel_file_version = 1;
+
+std::string tile_pixel_file_name(int world_size, int width, int height) {
+	return "./lua/default/tile-pixels-"
+		+ std::to_string(world_size) + "-"
+		+ std::to_string(width) + "x" + std::to_string(height) + ".bin";
+}
+
+bool read_tile_pixel_table(tile_pixel_table& table) {
+	std::ifstream file(tile_pixel_file_name(table.world_size, table.width, table.height), std::ios::binary);
+	if (!file) return false;
+
+	uint32_t header[6];
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (
+		!file
+		|| header[0] != tile_pixel_file_magic
+		|| header[1] != tile_pixel_file_version
+		|| header[2] != (uint32_t)table.world_size
+		|| header[3] != (uint32_t)table.width
+		|| header[4] != (uint32_t)table.height
+		|| header[5] != state.tile_size()
+	) {
+		return false;
+	}
+
+	table.pixel.resize(state.tile_size());
+	file.read(reinterpret_cast<char*>(table.pixel.data()), table.pixel.size() * sizeof(uint32_t));
+	return bool(file);
+}
+
+void write_tile_pixel_table(tile_pixel_table const& table) {
+	std::ofstream file(tile_pixel_file_name(table.world_size, table.width, table.height), std::ios::binary);
+	if (!file) return;
+
+	uint32_t header[6] = {
+		tile_pixel_file_magic,
+		tile_pixel_file_version,
+		(uint32_t)table.world_size,
+		(uint32_t)table.width,
+		(uint32_t)table.height,
+		(uint32_t)table.pixel.size()
+	};
+	file.write(reinterpret_cast<char const*>(header), sizeof(header));
+	file.write(reinterpret_cast<char const*>(table.pixel.data()), table.pixel.size() * sizeof(uint32_t));
+}
+
+tile_pixel_table const& get_tile_pixel_table(int world_size, int width, int height, bool persist) {
+	for (auto& table : tile_pixel_cache) {
+		if (
+			table->world_size == world_size
+			&& table->width == width
+			&& table->height == height
+			&& table->pixel.size() == state.tile_size()
+		) {
+			return *table;
+		}
+	}
+
+	auto& table = *tile_pixel_cache.emplace_back(std::make_unique<tile_pixel_table>());
+	table.world_size = world_size;
+	table.width = width;
+	table.height = height;
+
+	if (persist && read_tile_pixel_table(table)) {
+		return table;
+	}
+
+	table.pixel.resize(state.tile_size());
+	// exactly the tiles: vector padding would write past the table
+	concurrency::parallel_for(uint32_t(0), state.tile_size(), [&](auto i) {
+		dcon::tile_id tile {dcon::tile_id::value_base_t(i)};
+		auto sphere = tile_to_sphere(world_size, tile);
+		auto rect = sphere_to_rect(sphere);
+		table.pixel[i] = (uint32_t)rect_to_image_index(width, height, rect);
+	});
+
+	if (persist) {
+		write_tile_pixel_table(table);
+	}
+	return table;
+}
+
+struct world_image {
+	char const* filename;
+	uint8_t* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	tile_pixel_table const* pixel_table = nullptr;
+
+	uint8_t get(dcon::tile_id tile, int channel) const {
+		return pixels[pixel_table->pixel[tile.index()] * 4 + channel];
+	}
+};
+
+enum world_image_index : uint8_t {
+	image_tectonics,
+	image_waterflow_january,
+	image_waterflow_july,
+	image_heightmap,
+	image_soil_depth,
+	image_soil_organics,
+	image_soil_minerals,
+	image_soil_texture,
+	image_ice,
+	image_ice_age_ice,
+	image_rocks,
+	image_count
+};
+
+constexpr char const* world_image_files[image_count] = {
+	"./lua/default/tectonics.png",
+	"./lua/default/waterflow-january.png",
+	"./lua/default/waterflow-july.png",
+	"./lua/default/heightmap.png",
+	"./lua/default/soil-depth.png",
+	"./lua/default/soil-organics.png",
+	"./lua/default/soil-minerals.png",
+	"./lua/default/soil-texture.png",
+	"./lua/default/ice.png",
+	"./lua/default/ice-age-ice.png",
+	"./lua/default/rocks.png",
+};
+
+uint64_t world_images_fingerprint(int world_size) {
+	uint64_t result = rng::splitmix64((uint64_t)world_size);
+	for (auto filename : world_image_files) {
+		std::error_code error;
+		auto size = std::filesystem::file_size(filename, error);
+		if (error) size = 0;
+		auto time = std::filesystem::last_write_time(filename, error);
+		uint64_t ticks = error ? 0 : (uint64_t)time.time_since_epoch().count();
+		result = rng::splitmix64(result ^ (uint64_t)size);
+		result = rng::splitmix64(result ^ ticks);
+	}
+	// tiles also take bedrock ids by colour from the raws, so edited raws invalidate the bake
+	result = rng::splitmix64(result ^ (uint64_t)state.bedrock_size());
+	state.for_each_bedrock([&](auto bedrock) {
+		auto cid = rgb_to_id(
+			state.bedrock_get_r(bedrock) * 255.f,
+			state.bedrock_get_g(bedrock) * 255.f,
+			state.bedrock_get_b(bedrock) * 255.f
+		);
+		result = rng::splitmix64(result ^ (uint64_t)bedrock.index());
+		result = rng::splitmix64(result ^ (uint64_t)(uint32_t)cid);
+	});
+	return result;
+}
+
+void load_tiles_from_images(int world_size) {
+	// -- After we create the empty world, we can fill it with data...
+	printf("Decoding world images...");
+
+	std::array<world_image, image_count> images {};
+	for (uint32_t i = 0; i < image_count; i++) {
+		images[i].filename = world_image_files[i];
+	}
+
+	// decoding dominates loading time, so every image gets its own worker
+	concurrency::parallel_for(uint32_t(0), uint32_t(image_count), [&](auto i) {
+		int channels;
+		images[i].pixels = stbi_load(
+			images[i].filename,
+			&images[i].width,
+			&images[i].height,
+			&channels,
+			4
+		);
+		if (images[i].pixels == nullptr) {
+			printf("Failed to load %s: %s\n", images[i].filename, stbi_failure_reason());
+			exit(1);
+		}
+	});
+
+	for (auto& image : images) {
+		image.pixel_table = &get_tile_pixel_table(world_size, image.width, image.height, true);
+	}
+
+	printf("World images decoded!\n");
+
+	printf("Loading tectonics map...");
+
+	{
+		// plates are created in tile order, so this pass stays serial
+		ankerl::unordered_dense::map<int32_t, dcon::plate_id> detected_plates{};
+		auto& tectonics = images[image_tectonics];
+
+		state.for_each_tile([&](dcon::tile_id tile) {
+			auto r = tectonics.get(tile, 0);
+			auto g = tectonics.get(tile, 1);
+			auto b = tectonics.get(tile, 2);
+
+			auto cid = rgb_to_id(r, g, b);
+
+			auto it = detected_plates.find(cid);
+
+			if (it == detected_plates.end()) {
+				auto new_plate = state.create_plate();
+				state.plate_set_r(new_plate, (float)r / 255.f);
+				state.plate_set_g(new_plate, (float)g / 255.f);
+				state.plate_set_b(new_plate, (float)b / 255.f);
+				state.plate_set_direction(new_plate, 1);
+				detected_plates[cid] = new_plate;
+				state.force_create_plate_tiles(new_plate, tile);
+			} else {
+				state.force_create_plate_tiles(it->second, tile);
+			}
+		});
+	}
+
+	printf("Tectonic map loaded!\n");
+
+	printf("Generate tile neigbours\n");
+
+	float scaler_world = 1.f / float(world_size);
+	state.tile_resize_neighbour(4);
+
+	state.execute_parallel_over_tile([&](auto tiles) {
+		ve::apply([&](dcon::tile_id tile){
+			auto point = tile_to_sphere(world_size, tile);
+			auto box = sphere_to_box(point);
+			auto fst = tile_to_fst(world_size, tile);
+			auto shift_s = face_to_ds[fst.x] * scaler_world;
+			auto shift_t = face_to_dt[fst.x] * scaler_world;
+
+			state.tile_set_x(tile, point.x);
+			state.tile_set_y(tile, point.y);
+			state.tile_set_z(tile, point.z);
+
+			// 00 - forward
+			{
+				auto n = r3_to_tile(world_size, box + shift_s);
+				state.tile_set_neighbour(tile, 0, n);
+			}
+			// 01 - left
+			{
+				auto n = r3_to_tile(world_size, box - shift_t);
+				state.tile_set_neighbour(tile, 1, n);
+			}
+			// 10 - right
+			{
+				auto n = r3_to_tile(world_size, box + shift_t);
+				state.tile_set_neighbour(tile, 2, n);
+			}
+			// 11 - backward
+			{
+				auto n = r3_to_tile(world_size, box - shift_s);
+				state.tile_set_neighbour(tile, 3, n);
+
+				auto n_p = tile_to_sphere(world_size, state.tile_get_neighbour(tile, 3));
+				auto c_p = tile_to_sphere(world_size, tile);
+				auto distance = glm::distance(c_p, n_p);
+				assert(distance < scaler_world * 5.f);
+			}
+			assert(fst_to_tile(world_size, tile_to_fst(world_size, tile)) == tile);
+			assert(sphere_to_fst(world_size, point) == fst);
+			assert(glm::distance(point, fst_to_sphere(world_size, sphere_to_fst(world_size, point))) < scaler_world);
+		}, tiles);
+	});
+
+	printf("Tile neigbours are generated\n");
+
+	printf("Loading tile maps...");
+
+	{
+		// build a map for colors
+		ankerl::unordered_dense::map<int32_t, dcon::bedrock_id> color_to_bedrock{};
+
+		state.for_each_bedrock([&](auto bedrock){
+			auto cid = rgb_to_id(
+				state.bedrock_get_r(bedrock) * 255.f,
+				state.bedrock_get_g(bedrock) * 255.f,
+				state.bedrock_get_b(bedrock) * 255.f
+			);
+			color_to_bedrock[cid] = bedrock;
+		});
+
+		auto get_ice = [](uint8_t r, uint8_t g, uint8_t b) {
+			if (g == 255 && b == 255) {
+				if (r == 210)  return 10.f;
+				else if (r == 225)  return 25.f;
+				else if (r == 240)  return 40.f;
+				else return 0.f;
+			} else return 0.f;
+		};
+
+		auto& january = images[image_waterflow_january];
+		auto& july = images[image_waterflow_july];
+		auto& heightmap = images[image_heightmap];
+		auto& depth = images[image_soil_depth];
+		auto& organics = images[image_soil_organics];
+		auto& minerals = images[image_soil_minerals];
+		auto& texture = images[image_soil_texture];
+		auto& ice = images[image_ice];
+		auto& ice_age_ice = images[image_ice_age_ice];
+		auto& rocks = images[image_rocks];
+
+		// every tile reads only its own pixels, so all maps are applied in one sweep;
+		// exactly the tiles: pixel tables have no entries for vector padding
+		concurrency::parallel_for(uint32_t(0), state.tile_size(), [&](auto i) {
+			dcon::tile_id tile {dcon::tile_id::value_base_t(i)};
+			// hydro
+
+			auto r_july = july.get(tile, 0);
+			auto g_july = july.get(tile, 1);
+			auto b_july = july.get(tile, 2);
+
+			auto r_jan = january.get(tile, 0);
+			auto g_jan = january.get(tile, 1);
+			auto b_jan = january.get(tile, 2);
+
+			auto flow_july = color_waterflow(r_july, g_july, b_july);
+			auto flow_january = color_waterflow(r_jan, g_jan, b_jan);
+
+			auto land =
+				color_is_land(r_july, g_july, b_july)
+				|| color_is_land(r_jan, g_jan, b_jan);
+
+			auto is_fresh =
+				color_is_fresh(r_july, g_july, b_july)
+				|| color_is_land(r_jan, g_jan, b_jan);
+
+			state.tile_set_is_land(tile, land);
+			state.tile_set_is_fresh(tile, is_fresh);
+			state.tile_set_july_waterflow(tile, flow_july);
+			state.tile_set_january_waterflow(tile, flow_january);
+			state.tile_set_waterlevel(tile, 0);
+
+			if ((flow_july + flow_january) > 2000.0) {
+				state.tile_set_has_river(tile, true);
+			}
+
+			// elevation
+
+			auto sea_level = 94.f;
+			auto elev = (float)heightmap.get(tile, 0) - sea_level;
+			if (elev < 0) {
+				elev = elev / sea_level * 8000.f;
+			} else {
+				elev = elev / (255.f - sea_level) * 8000.f;
+			}
+			if (land) {
+				state.tile_set_elevation(tile, std::max(1.f, elev));
+			} else {
+				state.tile_set_elevation(tile, std::min(-1.f, elev));
+			}
+
+			// soils
+
+			float total = (float)texture.get(tile, 0) + (float)texture.get(tile, 1) + (float)texture.get(tile, 2);
+			if (total == 0) {
+				total = 0.001f;
+			}
+			auto sand = texture.get(tile, 0) / total;
+			auto silt = texture.get(tile, 1) / total;
+			auto clay = texture.get(tile, 2) / total;
+
+			auto depth_hsv = rgb_to_hsv(
+				(float) depth.get(tile, 0) / 255.f,
+				(float) depth.get(tile, 1) / 255.f,
+				(float) depth.get(tile, 2) / 255.f
+			);
+
+			auto actual_depth = depth_hsv.x;
+
+			state.tile_set_sand(tile, sand * actual_depth);
+			state.tile_set_silt(tile, silt * actual_depth);
+			state.tile_set_clay(tile, clay * actual_depth);
+
+			if (actual_depth == 0) {
+				state.tile_set_soil_minerals(tile, 0);
+				state.tile_set_soil_organics(tile, 0);
+			} else {
+				auto organics_value = rgb_to_hsv(organics.get(tile, 0), organics.get(tile, 1), organics.get(tile, 2)).x;
+				state.tile_set_soil_organics(tile, std::min(organics_value, 235.f) / 235.f);
+				auto minerals_value = rgb_to_hsv(minerals.get(tile, 0), minerals.get(tile, 1), minerals.get(tile, 2)).x;
+				state.tile_set_soil_minerals(tile, std::min(minerals_value, 235.f) / 235.f);
+			}
+
+			// ice
+
+			state.tile_set_ice(tile,
+				get_ice(ice.get(tile, 0), ice.get(tile, 1), ice.get(tile, 2))
+			);
+			state.tile_set_ice_age_ice(tile,
+				get_ice(ice_age_ice.get(tile, 0), ice_age_ice.get(tile, 1), ice_age_ice.get(tile, 2))
+			);
+
+			// rocks
+
+			auto cid = rgb_to_id(rocks.get(tile, 0), rocks.get(tile, 1), rocks.get(tile, 2));
+
+			auto it = color_to_bedrock.find(cid);
+
+			if (it == color_to_bedrock.end()) {
+				state.tile_set_bedrock(tile, dcon::bedrock_id{7});
+			} else {
+				state.tile_set_bedrock(tile, it->second);
+			}
+		});
+
+		// coast needs land of neighbours, so it waits for the sweep above
+		state.execute_parallel_over_tile([&](auto tiles) {
+			ve::apply([&](dcon::tile_id tile) {
+				auto is_land = state.tile_get_is_land(tile);
+				for (int i = 0; i < 4; i++) {
+					auto n = state.tile_get_neighbour(tile, i);
+					auto n_is_land = state.tile_get_is_land(n);
+					if (is_land != n_is_land) {
+						state.tile_set_is_coast(tile, true);
+						return;
+					}
+				}
+			}, tiles);
+		});
+	}
+
+	for (auto& image : images) {
+		stbi_image_free(image.pixels);
+	}
+
+	printf("Tile maps loaded!\n");
+}
+
+void spawn_races() {
+	// really basic
+	// to be replaced with whatever squealing is doing in the shadows
+	printf("Spawn races");
+	rng::counter_engine engine{ get_world_seed() };
+	std::uniform_real_distribution<float> uniform{0.0, 1.0};
+	state.pop_resize_dna(20);
+	state.for_each_race([&](dcon::race_id race){
+		state.for_each_tile([&](dcon::tile_id tile){
+			auto settlement = state.tile_get_settlement_from_settlement_tile(tile);
+			if (settlement) return;
+			if (!state.tile_get_is_land(tile)) return;
+
+
+			if (state.race_get_requires_large_river(race)) {
+				if (!state.tile_get_has_river(tile)) return;
+			}
+
+			if (state.race_get_requires_large_forest(race)) {
+				if(state.tile_get_conifer(tile) + state.tile_get_broadleaf(tile) < 0.5) return;
+			}
+
+			auto elevation = state.tile_get_elevation(tile);
+
+			auto january_temp = state.tile_get_january_temperature(tile);
+			auto july_temp = state.tile_get_july_temperature(tile);
+			auto min_temp = std::min(january_temp, july_temp);
+			auto avg_temp = (july_temp + january_temp) / 2.f;
+
+			if (state.race_get_minimum_comfortable_temperature(race) > avg_temp) return;
+			if (state.race_get_minimum_absolute_temperature(race) > min_temp) return;
+			if (state.race_get_minimum_comfortable_elevation(race) > elevation) return;
+
+			if (uniform(engine) > 0.0001f) return;
+
+			auto s = state.create_settlement();
+			state.force_create_settlement_tile(s, tile);
+
+			auto leader = state.create_pop();
+			pop_reset_age_cache(leader);
+			state.force_create_pop_location(s, leader);
+			state.pop_set_race(leader, race);
+			// set dna
+			for (int i = 0; i < 20; i ++) {
+				state.pop_set_dna(leader, i, uniform(engine));
+			}
+		});
+	});
+}
+
+void load_default_world(int world_size) {
+	auto fingerprint = world_images_fingerprint(world_size);
+	state.tile_resize_neighbour(4);
+	if (load_world_cache(world_cache_filename, fingerprint)) {
+		printf("Baked world loaded!\n");
+	} else {
+		load_tiles_from_images(world_size);
+		if (!save_world_cache(world_cache_filename, fingerprint)) {
+			printf("Failed to bake world into %s\n", world_cache_filename);
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+// cube sphere geometry and loading of the world from the default images
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "data.hpp"
+
+namespace cubeworld {
+	namespace top {
+		constexpr glm::vec3 origin = {-1.f, 1.f, -1.f};
+		constexpr glm::vec3 center = {0.f, 1.f, 0.f};
+		constexpr glm::vec3 ds = {2.f, 0.f, 0.f};
+		constexpr glm::vec3 dt = {0.f, 0.f, 2.f};
+		constexpr int face = 0;
+	}
+	namespace bottom {
+		constexpr glm::vec3 origin = {1.f, -1.f, -1.f};
+		constexpr glm::vec3 center = {0.f, -1.f, 0.f};
+		constexpr glm::vec3 ds = {-2.f, 0.f, 0.f};
+		constexpr glm::vec3 dt = {0.f, 0.f, 2.f};
+		constexpr int face = 1;
+	}
+	namespace left {
+		constexpr glm::vec3 origin = {-1.f, 1.f, 1.f};
+		constexpr glm::vec3 center = {-1.f, 0.f, 0.f};
+		constexpr glm::vec3 ds = {0.f, -2.f, 0.f};
+		constexpr glm::vec3 dt = {0.f, 0.f, -2.f};
+		constexpr int face = 2;
+	}
+	namespace right {
+		constexpr glm::vec3 origin = {1.f, -1.f, 1.f};
+		constexpr glm::vec3 center = {1.f, 0.f, 0.f};
+		constexpr glm::vec3 ds = {0.f, 2.f, 0.f};
+		constexpr glm::vec3 dt = {0.f, 0.f, -2.f};
+		constexpr int face = 3;
+	}
+	namespace forward {
+		constexpr glm::vec3 origin = {-1.f, -1.f, 1.f};
+		constexpr glm::vec3 center = {0.f, 0.f, 1.f};
+		constexpr glm::vec3 ds = {0.f, 2.f, 0.f};
+		constexpr glm::vec3 dt = {2.f, 0.f, 0.f};
+		constexpr int face = 4;
+	}
+	namespace back {
+		constexpr glm::vec3 origin = {1.f, -1.f, -1.f};
+		constexpr glm::vec3 center = {0.f, 0.f, -1.f};
+		constexpr glm::vec3 ds = {0.f, 2.f, 0.f};
+		constexpr glm::vec3 dt = {-2.f, 0.f, 0.f};
+		constexpr int face = 5;
+	}
+}
+
+constexpr glm::vec3 face_to_center[6] {
+	cubeworld::top::center,
+	cubeworld::bottom::center,
+	cubeworld::left::center,
+	cubeworld::right::center,
+	cubeworld::forward::center,
+	cubeworld::back::center,
+};
+constexpr glm::vec3 face_to_origin[6] {
+	cubeworld::top::origin,
+	cubeworld::bottom::origin,
+	cubeworld::left::origin,
+	cubeworld::right::origin,
+	cubeworld::forward::origin,
+	cubeworld::back::origin,
+};
+constexpr glm::vec3 face_to_ds[6] {
+	cubeworld::top::ds,
+	cubeworld::bottom::ds,
+	cubeworld::left::ds,
+	cubeworld::right::ds,
+	cubeworld::forward::ds,
+	cubeworld::back::ds,
+};
+constexpr glm::vec3 face_to_dt[6] {
+	cubeworld::top::dt,
+	cubeworld::bottom::dt,
+	cubeworld::left::dt,
+	cubeworld::right::dt,
+	cubeworld::forward::dt,
+	cubeworld::back::dt,
+};
+
+glm::vec3 fst_to_sphere(int world_size, glm::ivec3 fst);
+uint8_t sphere_to_face(glm::vec3 point);
+glm::vec3 sphere_to_box(glm::vec3 point);
+glm::ivec3 sphere_to_fst(int world_size, glm::vec3 point);
+dcon::tile_id fst_to_tile(int world_size, glm::ivec3 fst);
+dcon::tile_id r3_to_tile(int world_size, glm::vec3 point);
+glm::ivec3 tile_to_fst(int world_size, dcon::tile_id tile);
+glm::vec3 tile_to_sphere(int world_size, dcon::tile_id tile);
+glm::vec2 sphere_to_rect(glm::vec3 point);
+int rect_to_image_index(int width, int height, glm::vec2 point);
+
+glm::vec3 rgb_to_hsv(float r, float g, float b);
+int rgb_to_id(int r, int g, int b);
+bool color_is_land(uint8_t r, uint8_t g, uint8_t b);
+bool color_is_fresh(uint8_t r, uint8_t g, uint8_t b);
+float color_waterflow(uint8_t r, uint8_t g, uint8_t b);
+
+// pixel of an equirectangular image which covers each tile
+struct tile_pixel_table {
+	int world_size = 0;
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> pixel;
+};
+
+tile_pixel_table const& get_tile_pixel_table(int world_size, int width, int height, bool persist);
+
+constexpr char const* world_cache_filename = "./lua/default/world-cache.bin";
+
+// a baked world is valid only for the images, world size and bedrock raws it was baked from,
+// so raws have to be loaded first
+uint64_t world_images_fingerprint(int world_size);
+// fills tiles and plates from the default images
+void load_tiles_from_images(int world_size);
+// baked world when it is up to date, images otherwise
+void load_default_world(int world_size);
+// first settlements with a leader pop, after lua finished the world
+void spawn_races();